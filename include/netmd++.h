@@ -33,7 +33,7 @@
 # netmd++
 This C++ API was written to ease the handling of NetMD devices. It is a synchronous API.
 So, function calls might block your program flow. If you want to use this API in an GUI app,
-better put the API calls into a background thread.
+use the CNetMdAsync facade, which runs the API calls on a worker thread.
 
 ## Supported Devices
 |Manufacturer | Manufacturer ID | Device ID | Name                      | Type  |
@@ -143,6 +143,48 @@ int main()
 }
 ~~~
 
+### Asynchronous calls
+~~~
+#include <netmd++.h>
+
+int main()
+{
+    netmd::netmd_pp netMd;
+    netMd.initHotPlug();
+
+    netmd::CNetMdAsync async(netMd);
+
+    // long running upload with low priority
+    std::future<int> upload = async.submit([](netmd::netmd_pp& api) {
+        return api.sendAudioFile("/path/to/nice/audio.wav", "Nice Audio", netmd::NO_ONTHEFLY_CONVERSION);
+    }, netmd::CNetMdAsync::Prio::LOW);
+
+    // meta data query, result through callback (called on worker thread);
+    // it runs before any queued upload, but after one already running
+    async.post([](netmd::netmd_pp& api) { return api.trackCount(); },
+               [](int count) { std::cout << count << " tracks" << std::endl; },
+               netmd::CNetMdAsync::Prio::HIGH);
+
+    return upload.get();
+}
+~~~
+
+With C++20 the same calls can be awaited through a thin coroutine wrapper over
+CNetMdAsync (the calls still run - and block - on the device's worker thread):
+configure with <tt>-DNETMD_COROUTINES=ON</tt>,
+link against <tt>netmd++coro</tt> and use CNetMdCoro from <tt>netmd++coro.h</tt>:
+~~~
+netmd::CNetMdTask listTracks(netmd::CNetMdCoro& coro)
+{
+    int count = co_await coro.trackCount();
+    for (int i = 0; i < count; i++)
+    {
+        netmd::CoResult<std::string> title = co_await coro.trackTitle(i);
+        std::cout << title.mValue << std::endl;
+    }
+}
+~~~
+
 ### Erase disc and set new title
 ~~~
 #include <netmd++.h>
@@ -245,7 +287,14 @@ delete [] pData;
 #include <vector>
 #include <ctime>
 #include <functional>
+#include <map>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <thread>
+#include <type_traits>
 
 namespace netmd {
 
@@ -371,6 +420,47 @@ enum HomebrewFeatures : uint32_t
 /// netmd groups
 using Groups = std::vector<Group>;
 
+//-----------------------------------------------------------------------------
+//! @brief      all meta data of one track
+//-----------------------------------------------------------------------------
+struct TrackInfo
+{
+    uint16_t        mNo;            //!< track number (starting with 0)
+    std::string     mTitle;         //!< track title
+    TrackTime       mTime;          //!< track length
+    AudioEncoding   mEncoding;      //!< audio encoding
+    uint8_t         mChannel;       //!< channel flag
+    TrackProtection mProtection;    //!< track protection
+    uint32_t        mLengthMs;      //!< exact length in ms (UTOC listing only)
+    std::time_t     mTStamp;        //!< recording time (UTOC listing only)
+};
+
+/// track info list
+using TrackInfos = std::vector<TrackInfo>;
+
+//-----------------------------------------------------------------------------
+//! @brief      snapshot of the disc content
+//-----------------------------------------------------------------------------
+struct DiscSnapshot
+{
+    bool        mValid;     //!< true if snapshot is valid
+    int         mDiscFlags; //!< disc flags
+    std::string mDiscTitle; //!< disc title
+    Groups      mGroups;    //!< track groups
+    TrackInfos  mTracks;    //!< all tracks
+};
+
+//-----------------------------------------------------------------------------
+//! @brief      one track of an album upload
+//-----------------------------------------------------------------------------
+struct AlbumTrack
+{
+    std::string mFileName;  //!< PCM WAVE file (44.1kHz / 16 bit)
+    std::string mTitle;     //!< track title
+};
+
+using AlbumTracks = std::vector<AlbumTrack>;
+
 /// byte vector
 using NetMDByteVector = std::vector<uint8_t>;
 
@@ -381,6 +471,13 @@ using NetMDByteVector = std::vector<uint8_t>;
 //--------------------------------------------------------------------------
 using EvtCallback = std::function<void(bool)>;
 
+//--------------------------------------------------------------------------
+//! @brief progress callback function signature
+//
+//! @param[in]  progress in percent (0 ... 100)
+//--------------------------------------------------------------------------
+using ProgressCallback = std::function<void(int)>;
+
 //--------------------------------------------------------------------------
 //! @brief      format helper for TrackTime
 //!
@@ -487,6 +584,48 @@ public:
     //--------------------------------------------------------------------------
     static void setLogStream(std::ostream& os);
 
+    //--------------------------------------------------------------------------
+    //! @brief      Enables / disables asynchronous logging. Log records are
+    //!             written by a background thread, so logging doesn't add
+    //!             to the device I/O timing.
+    //!
+    //! @param[in]  async        true -> log through writer thread
+    //! @param[in]  blockIfFull  if the log ring is full: true -> wait;
+    //!                          false -> drop the message
+    //--------------------------------------------------------------------------
+    static void setLogAsync(bool async, bool blockIfFull = false);
+
+    //--------------------------------------------------------------------------
+    //! @brief      Sets the device cache file. Firmware version and patch
+    //!             slot contents are remembered per device in this file, so
+    //!             that a reconnect doesn't need the full device discovery.
+    //!             Patch slots are verified with one read; the firmware
+    //!             version isn't, so remove the file after a firmware
+    //!             update.
+    //!
+    //! @param[in]  file  The cache file name (empty -> no cache)
+    //--------------------------------------------------------------------------
+    static void setDeviceCache(const std::string& file);
+
+    //--------------------------------------------------------------------------
+    //! @brief      enable / disable the USB trace. Every USB exchange is
+    //!             recorded with its timing in a ring of the given size;
+    //!             enabling drops all recorded events.
+    //!
+    //! @param[in]  events  The ring size in events (0 -> disable)
+    //--------------------------------------------------------------------------
+    void enableTrace(size_t events = 4096);
+
+    //--------------------------------------------------------------------------
+    //! @brief      export the USB trace as Chrome trace JSON (can be opened in
+    //!             chrome://tracing or the Perfetto UI)
+    //!
+    //! @param      os    The stream to write to
+    //!
+    //! @return     number of exported events
+    //--------------------------------------------------------------------------
+    size_t exportTrace(std::ostream& os);
+
     //--------------------------------------------------------------------------
     //! @brief      request track count
     //!
@@ -546,6 +685,16 @@ public:
     //--------------------------------------------------------------------------
     int moveTrack(uint16_t from, uint16_t to);
 
+    //--------------------------------------------------------------------------
+    //! @brief      reorder all tracks with the fewest possible moves
+    //!
+    //! @param[in]  newOrder  old track numbers in new order
+    //!                       (newOrder[0] -> becomes track 0)
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int reorderTracks(const std::vector<uint16_t>& newOrder);
+
     //--------------------------------------------------------------------------
     //! @brief      Sets the group title.
     //!
@@ -605,6 +754,16 @@ public:
     //--------------------------------------------------------------------------
     int deleteTrack(uint16_t track);
 
+    //--------------------------------------------------------------------------
+    //! @brief      delete several tracks at once; the group header is
+    //!             updated locally and written once
+    //!
+    //! @param[in]  tracks  The track numbers
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int deleteTracks(const std::vector<uint16_t>& tracks);
+
     //--------------------------------------------------------------------------
     //! @brief      get track bitrate data
     //!
@@ -699,6 +858,68 @@ public:
     //--------------------------------------------------------------------------
     int sendAudioFile(const std::string& filename, const std::string& title, DiskFormat otf);
 
+    //--------------------------------------------------------------------------
+    //! @brief      Sends an album as one gapless recording
+    //!
+    //! Only available if @ref tocManipSupported returns true. All files are
+    //! transferred in one go as a single track, which is then split through
+    //! UTOC edit. Split points are placed on sound group borders computed
+    //! from the sample counts. Titles and recording time are written to the
+    //! UTOC and the TOC is finalized once (includes a device reset).
+    //! All files must be PCM WAVE files (44.1kHz / 16 bit) with the same
+    //! channel count.
+    //!
+    //! @param[in]  tracks  The album tracks in play order
+    //! @param[in]  otf     The disk format
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int sendAlbum(const AlbumTracks& tracks, DiskFormat otf);
+
+    //--------------------------------------------------------------------------
+    //! @brief      Sends an album described by a CUE sheet
+    //!
+    //! Same as @ref sendAlbum, but the album is one PCM WAVE file and the
+    //! track borders and titles are taken from the CUE sheet (one FILE entry,
+    //! INDEX 01 marks the track start).
+    //!
+    //! @param[in]  cueFile  The CUE sheet
+    //! @param[in]  otf      The disk format
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int sendCueAlbum(const std::string& cueFile, DiskFormat otf);
+
+    //--------------------------------------------------------------------------
+    //! @brief      split a track without audio transfer
+    //!
+    //! Only available if @ref tocManipSupported returns true. The track is
+    //! split through UTOC edit, the second part becomes the next track
+    //! (untitled) and joins the group of the split track. Finalizes the TOC
+    //! (includes a device reset).
+    //!
+    //! @param[in]  track   The track number (starting with 0)
+    //! @param[in]  groups  The split position in sound groups from track start
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int splitTrack(uint16_t track, uint32_t groups);
+
+    //--------------------------------------------------------------------------
+    //! @brief      join two tracks without audio transfer
+    //!
+    //! Only available if @ref tocManipSupported returns true. The audio of
+    //! the second track is appended to the first track through UTOC edit;
+    //! the second track with its title is removed. Both tracks must use the
+    //! same encoding. Finalizes the TOC (includes a device reset).
+    //!
+    //! @param[in]  first   The first track number (starting with 0)
+    //! @param[in]  second  The second track number (starting with 0)
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int joinTracks(uint16_t first, uint16_t second);
+
     //--------------------------------------------------------------------------
     //! @brief      Sets the track title.
     //!
@@ -709,6 +930,15 @@ public:
     //--------------------------------------------------------------------------
     int setTrackTitle(uint16_t trackNo, const std::string& title);
 
+    //--------------------------------------------------------------------------
+    //! @brief      Sets several track titles at once.
+    //!
+    //! @param[in]  titles  track number -> title
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int setTrackTitles(const std::map<uint16_t, std::string>& titles);
+
     //--------------------------------------------------------------------------
     //! @brief      get disc capacity
     //!
@@ -725,6 +955,36 @@ public:
     //--------------------------------------------------------------------------
     Groups groups();
 
+    //--------------------------------------------------------------------------
+    //! @brief      get a snapshot of all disc and track meta data
+    //!
+    //! All track data is read in one pass and cached. The cache is dropped
+    //! on write access, disc change and hotplug events. While the device is
+    //! blocked by another thread (e.g. track upload), the cached snapshot is
+    //! returned without waiting for the device.
+    //!
+    //! @param[out] snap     The buffer for the snapshot
+    //! @param[in]  refresh  force re-read if true (optional)
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int discSnapshot(DiscSnapshot& snap, bool refresh = false);
+
+    //--------------------------------------------------------------------------
+    //! @brief      list all tracks from UTOC
+    //!
+    //! Only available if @ref tocManipSupported returns true. Reads the UTOC
+    //! sectors @ref POS_ADDR, @ref HW_TITLES and @ref TSTAMPS once and decodes
+    //! title, exact length, encoding, channels and recording time of all
+    //! tracks. Track protection isn't part of the UTOC and will be set to
+    //! TrackProtection::UNKNOWN.
+    //!
+    //! @param[out] tracks  The buffer for track information
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int utocTrackList(TrackInfos& tracks);
+
     //--------------------------------------------------------------------------
     //! @brief      prepare TOC manipulation
     //!
@@ -755,7 +1015,7 @@ public:
     //! @brief      finalize TOC through exploit
     //!
     //! @param[in]  reset      do reset if true (default: false)
-    //! @param[in]  resetWait  The optional reset wait time (15 seconds)
+    //! @param[in]  resetWait  The optional max. reset wait time (15 seconds)
     //!                        Only needed if reset is true
     //!
     //! @return     NetMdErr
@@ -791,6 +1051,14 @@ public:
     //--------------------------------------------------------------------------
     void registerForHotplugEvents(EvtCallback cb);
 
+    //--------------------------------------------------------------------------
+    //! @brief      register TOC progress callback function
+    //
+    //! @param[in]  cb  callback function to be called with the progress of
+    //!                 finalizeTOC(); if is nullptr, progress is logged
+    //--------------------------------------------------------------------------
+    void registerForTOCProgress(ProgressCallback cb);
+
 private:
     /// disc header
     CMDiscHeader* mpDiscHeader;
@@ -806,12 +1074,24 @@ private:
 
     /// mutex for hotplug callback
     std::mutex mMutexHotplug;
+
+    /// TOC progress callback function
+    ProgressCallback mTOCProgressCallback;
+
+    /// cached disc snapshot
+    DiscSnapshot mSnapshot;
+
+    /// mutex for disc snapshot
+    std::mutex mMtxSnapshot;
 };
 
 namespace toc
 {
     /// internally used TOC structure
     struct TOC;
+
+    //! occupancy map with one bit per TOC slot (bit n -> slot n)
+    using SlotMap = uint64_t[4];
 }
 
 //------------------------------------------------------------------------------
@@ -919,6 +1199,42 @@ public:
     //--------------------------------------------------------------------------
     std::string discInfo() const;
 
+    //--------------------------------------------------------------------------
+    //! @brief      get sound group count of a track
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     sound groups
+    //--------------------------------------------------------------------------
+    uint32_t trackGroups(int trackNo) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get exact track length computed from sound groups
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     length in milliseconds
+    //--------------------------------------------------------------------------
+    uint32_t trackLength(int trackNo) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track mode (see mode flags in md_toc.h)
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     mode of first track fragment
+    //--------------------------------------------------------------------------
+    uint8_t trackMode(int trackNo) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track time stamp
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     recording time (UTC) or 0 if not set
+    //--------------------------------------------------------------------------
+    std::time_t trackTStamp(int trackNo) const;
+
 private:
     /// TOC pointer
     toc::TOC* mpToc;
@@ -940,7 +1256,427 @@ private:
 
     /// the fragments used for DAO track
     DAOFragments mDAOFragments;
+
+    /// occupied title cells (bit n -> cell n)
+    toc::SlotMap mUsedCells;
+
+    /// occupied track fragments (bit n -> fragment n)
+    toc::SlotMap mUsedFrags;
 };
 
+//------------------------------------------------------------------------------
+//! @brief      This class models the UTOC of a MiniDisc.
+//------------------------------------------------------------------------------
+class CNetMdUTOC
+{
+public:
+    /// size of one UTOC sector
+    static constexpr size_t  SECTOR_SIZE  = 2352;
+
+    /// number of UTOC sectors we handle (0 ... 4)
+    static constexpr uint8_t SECTOR_COUNT = 5;
+
+    /// address sector
+    static constexpr uint8_t POS_SECTOR   = 0;
+
+    /// half width titles
+    static constexpr uint8_t HW_SECTOR    = 1;
+
+    /// time stamps
+    static constexpr uint8_t TS_SECTOR    = 2;
+
+    /// full width titles (note: on disc this is sector 4)
+    static constexpr uint8_t FW_SECTOR    = 4;
+
+    /// one contiguous range of sound groups (end is inclusive)
+    struct Range
+    {
+        uint32_t mStart;    ///< first sound group
+        uint32_t mEnd;      ///< last sound group
+        uint8_t  mMode;     ///< track mode
+    };
+
+    using Ranges = std::vector<Range>;
+
+    /// block size used for image diff (same as UTOC write blocks)
+    static constexpr size_t  BLOCK_SIZE   = 0x10;
+
+    /// a run of changed bytes in one sector
+    struct DiffBlock
+    {
+        uint8_t  mSector;   ///< sector number
+        uint16_t mOffset;   ///< offset in sector (multiple of BLOCK_SIZE)
+        uint16_t mSize;     ///< size in bytes (multiple of BLOCK_SIZE)
+    };
+
+    using DiffBlocks = std::vector<DiffBlock>;
+
+    //--------------------------------------------------------------------------
+    //! @brief      Constructs a new instance.
+    //--------------------------------------------------------------------------
+    CNetMdUTOC();
+
+    //--------------------------------------------------------------------------
+    //! @brief      load one UTOC sector
+    //!
+    //! @param[in]  sector  The sector number (0, 1, 2, 4)
+    //! @param[in]  data    The sector data (SECTOR_SIZE bytes)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int load(uint8_t sector, const NetMDByteVector& data);
+
+    //--------------------------------------------------------------------------
+    //! @brief      get one UTOC sector as it has to be written to the disc
+    //!
+    //! @param[in]  sector  The sector number (0, 1, 2, 4)
+    //!
+    //! @return     sector data; empty if not loaded
+    //--------------------------------------------------------------------------
+    NetMDByteVector store(uint8_t sector) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      load an UTOC image file (sectors 0 ... n back to back)
+    //!
+    //! @param[in]  fName  The file name
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int loadFile(const std::string& fName);
+
+    //--------------------------------------------------------------------------
+    //! @brief      save UTOC image to file; sectors in between which
+    //!             weren't loaded are written as zeros.
+    //!
+    //! @param[in]  fName  The file name
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int saveFile(const std::string& fName) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      compare with another image block wise
+    //!
+    //! @param[in]  other  The other image
+    //!
+    //! @return     runs of changed blocks
+    //--------------------------------------------------------------------------
+    DiffBlocks diff(const CNetMdUTOC& other) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      check image consistency: link cycles, overlapping
+    //!             fragments, dangling title links and bad addresses
+    //!
+    //! @param[out] errors  The errors found
+    //!
+    //! @return     0 -> ok; -1 -> errors found
+    //--------------------------------------------------------------------------
+    int validate(std::vector<std::string>& errors) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      check if sector was loaded
+    //!
+    //! @param[in]  sector  The sector number
+    //!
+    //! @return     true if loaded
+    //--------------------------------------------------------------------------
+    bool loaded(uint8_t sector) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      check if sector was changed since loading
+    //!
+    //! @param[in]  sector  The sector number
+    //!
+    //! @return     true if changed
+    //--------------------------------------------------------------------------
+    bool dirty(uint8_t sector) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      mark all sectors as clean (e.g. after writing them)
+    //--------------------------------------------------------------------------
+    void clearDirty();
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track count
+    //!
+    //! @return     number of tracks; -1 if address sector isn't loaded
+    //--------------------------------------------------------------------------
+    int trackCount() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get the audio ranges of a track
+    //!
+    //! @param[in]  track  The track number (starting with 1)
+    //!
+    //! @return     ranges in play order
+    //--------------------------------------------------------------------------
+    Ranges trackRanges(int track) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get the free space on disc
+    //!
+    //! @return     free ranges in free list order
+    //--------------------------------------------------------------------------
+    Ranges freeRanges() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get the length of a track in sound groups
+    //!
+    //! @param[in]  track  The track number (starting with 1)
+    //!
+    //! @return     sound groups
+    //--------------------------------------------------------------------------
+    uint32_t trackGroups(int track) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track title
+    //!
+    //! @param[in]  track      The track number (0 -> disc title)
+    //! @param[in]  fullWidth  use full width title sector
+    //!
+    //! @return     title
+    //--------------------------------------------------------------------------
+    std::string title(int track, bool fullWidth = false) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track time stamp
+    //!
+    //! @param[in]  track  The track number (0 -> disc)
+    //!
+    //! @return     time stamp; 0 if not set
+    //--------------------------------------------------------------------------
+    std::time_t tstamp(int track) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      set track title; the old title cells are released
+    //!             once the new title fits
+    //!
+    //! @param[in]  track      The track number (0 -> disc title)
+    //! @param[in]  title      The title (empty removes it)
+    //! @param[in]  fullWidth  use full width title sector
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int setTitle(int track, const std::string& title, bool fullWidth = false);
+
+    //--------------------------------------------------------------------------
+    //! @brief      set track time stamp
+    //!
+    //! @param[in]  track   The track number (0 -> disc)
+    //! @param[in]  tstamp  The time stamp
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int setTStamp(int track, std::time_t tstamp);
+
+    //--------------------------------------------------------------------------
+    //! @brief      take space from the free list (first fit in free list order)
+    //!
+    //! @param[in]  groups  The number of sound groups needed
+    //! @param[in]  mode    The track mode for the returned ranges
+    //! @param[out] ranges  The ranges taken
+    //!
+    //! @return     0 -> ok; -1 -> not enough free space
+    //--------------------------------------------------------------------------
+    int claimFree(uint32_t groups, uint8_t mode, Ranges& ranges);
+
+    //--------------------------------------------------------------------------
+    //! @brief      insert a new track; ranges must not be used by any track
+    //!
+    //! Parts of the ranges found in the free list are removed from it.
+    //! Following tracks are shifted up.
+    //!
+    //! @param[in]  track   The new track number (1 ... trackCount() + 1)
+    //! @param[in]  ranges  The audio ranges in play order
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int insertTrack(int track, const Ranges& ranges);
+
+    //--------------------------------------------------------------------------
+    //! @brief      erase a track; its audio is given back to the free list,
+    //!             titles and time stamp are released.
+    //!
+    //! @param[in]  track  The track number (starting with 1)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int eraseTrack(int track);
+
+    //--------------------------------------------------------------------------
+    //! @brief      move a track
+    //!
+    //! @param[in]  from  The source track number (starting with 1)
+    //! @param[in]  to    The destination track number (starting with 1)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int moveTrack(int from, int to);
+
+    //--------------------------------------------------------------------------
+    //! @brief      split a track; the second part becomes the next track
+    //!             (without title and time stamp), following tracks are
+    //!             shifted up.
+    //!
+    //! @param[in]  track   The track number (starting with 1)
+    //! @param[in]  groups  The split position in sound groups from track start
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int splitTrack(int track, uint32_t groups);
+
+    //--------------------------------------------------------------------------
+    //! @brief      join two tracks; the audio of the second track is appended
+    //!             to the first one, the second track is removed.
+    //!
+    //! @param[in]  first   The first track number (starting with 1)
+    //! @param[in]  second  The second track number (starting with 1)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int joinTracks(int first, int second);
+
+private:
+    /// raw sector images
+    NetMDByteVector mSectors[SECTOR_COUNT];
+
+    /// changed sectors (bit per sector)
+    uint8_t mDirty;
+
+    /// used fragment slots
+    uint64_t mUsedFrags[4];
+
+    /// used title cells (half / full width)
+    uint64_t mUsedCells[2][4];
+
+    /// used time stamp slots
+    uint64_t mUsedTimes[4];
+
+    /// bitmaps and free chains match the images
+    bool mSlotMapsValid;
+};
+
+
+//------------------------------------------------------------------------------
+//! @brief      Asynchronous facade for CNetMdApi. All jobs for one device
+//!             run in order on a single worker thread. Jobs with higher
+//!             priority are served before queued jobs of lower priority.
+//!             A running job is never interrupted: an upload keeps the
+//!             device for the whole transfer, so queries queued meanwhile
+//!             run after it. Use CNetMdApi::discSnapshot() from another
+//!             thread to get cached meta data during an upload.
+//------------------------------------------------------------------------------
+class CNetMdAsync
+{
+public:
+    /// job priority
+    enum class Prio : uint8_t
+    {
+        HIGH,       //!< short meta data queries
+        NORMAL,     //!< default
+        LOW,        //!< long running jobs (uploads, TOC edits)
+        MAX_PRIO    //!< number of priorities
+    };
+
+    /// a job running on the worker thread
+    using Job = std::function<void(CNetMdApi&)>;
+
+    //--------------------------------------------------------------------------
+    //! @brief      Constructs a new instance and starts the worker thread.
+    //!
+    //! @param[in]  api   The API instance of the device (must outlive us)
+    //--------------------------------------------------------------------------
+    CNetMdAsync(CNetMdApi& api);
+
+    //--------------------------------------------------------------------------
+    //! @brief      Destroys the object. Waits for the running job, pending
+    //!             jobs are dropped (futures report broken promise).
+    //--------------------------------------------------------------------------
+    ~CNetMdAsync();
+
+    //--------------------------------------------------------------------------
+    //! @brief      queue a job, get the result through a future
+    //!
+    //! @param[in]  f     callable taking CNetMdApi&
+    //! @param[in]  prio  The priority
+    //!
+    //! @return     future for the result of f
+    //--------------------------------------------------------------------------
+    template<typename F>
+    auto submit(F&& f, Prio prio = Prio::NORMAL) -> std::future<std::invoke_result_t<F, CNetMdApi&>>
+    {
+        using Ret  = std::invoke_result_t<F, CNetMdApi&>;
+        auto  task = std::make_shared<std::packaged_task<Ret(CNetMdApi&)>>(std::forward<F>(f));
+        std::future<Ret> fut = task->get_future();
+        enqueue([task](CNetMdApi& api) { (*task)(api); }, prio);
+        return fut;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      queue a job, get the result through a callback; the
+    //!             callback is called on the worker thread
+    //!
+    //! @param[in]  f     callable taking CNetMdApi&
+    //! @param[in]  cb    completion callback taking the result of f
+    //!                   (or nothing if f returns void)
+    //! @param[in]  prio  The priority
+    //--------------------------------------------------------------------------
+    template<typename F, typename CB>
+    void post(F&& f, CB&& cb, Prio prio = Prio::NORMAL)
+    {
+        enqueue([f = std::forward<F>(f), cb = std::forward<CB>(cb)](CNetMdApi& api) mutable
+        {
+            if constexpr (std::is_void_v<std::invoke_result_t<F, CNetMdApi&>>)
+            {
+                f(api);
+                cb();
+            }
+            else
+            {
+                cb(f(api));
+            }
+        }, prio);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      number of queued jobs (running job not included)
+    //!
+    //! @return     pending jobs
+    //--------------------------------------------------------------------------
+    size_t pending() const;
+
+protected:
+    //--------------------------------------------------------------------------
+    //! @brief      add a job to the queue
+    //!
+    //! @param[in]  job   The job
+    //! @param[in]  prio  The priority
+    //--------------------------------------------------------------------------
+    void enqueue(Job job, Prio prio);
+
+    //--------------------------------------------------------------------------
+    //! @brief      worker thread function
+    //--------------------------------------------------------------------------
+    void worker();
+
+private:
+    /// the API instance
+    CNetMdApi& mApi;
+
+    /// job queues, one per priority
+    std::deque<Job> mJobs[static_cast<size_t>(Prio::MAX_PRIO)];
+
+    /// protects job queues
+    mutable std::mutex mMtxJobs;
+
+    /// signals new jobs / stop
+    std::condition_variable mCondJobs;
+
+    /// stop marker
+    bool mStop;
+
+    /// the worker thread
+    std::thread mWorker;
+};
 
 } // ~namespace
@@ -0,0 +1,317 @@
+/*
+ * netmd++coro.h
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/**
+@file netmd++coro.h
+
+# Coroutine wrapper
+C++20 coroutine wrapper over CNetMdAsync. Every call is handed to the
+worker thread of one device as an ordinary job; the awaiting coroutine is
+resumed on that thread when the job is done.
+
+This is a convenience interface only. There is no I/O executor behind
+it: the USB layer stays synchronous, so the blocking transfers and the
+polling sleeps (response length, TOC finalization) still occupy the
+worker thread. Each device keeps needing its own worker thread.
+*/
+#pragma once
+
+#if (__cplusplus < 202002L) && !defined(__cpp_impl_coroutine)
+#error "netmd++coro.h needs C++20 coroutine support!"
+#endif
+
+#include "netmd++.h"
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <variant>
+
+namespace netmd {
+
+//------------------------------------------------------------------------------
+//! @brief      result of a coroutine call which fills an output parameter
+//------------------------------------------------------------------------------
+template<typename T>
+struct CoResult
+{
+    int mErr;   //!< NetMdErr
+    T mValue;   //!< the value (valid if mErr == NETMDERR_NO_ERROR)
+};
+
+//------------------------------------------------------------------------------
+//! @brief      Awaitable which runs a job on the worker thread of a
+//!             CNetMdAsync instance. The awaiting coroutine is resumed on
+//!             that worker thread once the job is done.
+//------------------------------------------------------------------------------
+template<typename F>
+class CNetMdAwaiter
+{
+    /// return type of the job
+    using Ret = std::invoke_result_t<F, CNetMdApi&>;
+
+    /// storage for the result
+    using Store = std::conditional_t<std::is_void_v<Ret>, std::monostate, std::optional<Ret>>;
+
+public:
+    //--------------------------------------------------------------------------
+    //! @brief      Constructs a new instance.
+    //!
+    //! @param[in]  async  The async facade of the device
+    //! @param[in]  f      callable taking CNetMdApi&
+    //! @param[in]  prio   The priority
+    //--------------------------------------------------------------------------
+    CNetMdAwaiter(CNetMdAsync& async, F f, CNetMdAsync::Prio prio)
+        : mAsync(async), mF(std::move(f)), mPrio(prio), mResult{}, mExcept{}
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      never ready, the job has to run on the worker
+    //--------------------------------------------------------------------------
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      queue the job; resume the coroutine when it's done
+    //!
+    //! @param[in]  h     handle of awaiting coroutine
+    //--------------------------------------------------------------------------
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        mAsync.post([this](CNetMdApi& api)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<Ret>)
+                {
+                    mF(api);
+                }
+                else
+                {
+                    mResult.emplace(mF(api));
+                }
+            }
+            catch (...)
+            {
+                mExcept = std::current_exception();
+            }
+        },
+        [h]() { h.resume(); }, mPrio);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      hand out the job result (or re-throw its exception)
+    //--------------------------------------------------------------------------
+    Ret await_resume()
+    {
+        if (mExcept)
+        {
+            std::rethrow_exception(mExcept);
+        }
+
+        if constexpr (!std::is_void_v<Ret>)
+        {
+            return std::move(*mResult);
+        }
+    }
+
+private:
+    CNetMdAsync& mAsync;
+    F mF;
+    CNetMdAsync::Prio mPrio;
+    Store mResult;
+    std::exception_ptr mExcept;
+};
+
+//------------------------------------------------------------------------------
+//! @brief      minimal fire and forget coroutine type; starts eagerly and
+//!             cleans up after itself
+//------------------------------------------------------------------------------
+struct CNetMdTask
+{
+    struct promise_type
+    {
+        CNetMdTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+//------------------------------------------------------------------------------
+//! @brief      co_await-able NetMD operations; a coroutine facade over
+//!             the job queue of one CNetMdAsync instance. Each call is
+//!             queued on its worker thread and runs there like any other
+//!             job, so calls are still serialized per device. Code after
+//!             co_await continues on that worker thread.
+//------------------------------------------------------------------------------
+class CNetMdCoro
+{
+public:
+    using Prio = CNetMdAsync::Prio;
+
+    //--------------------------------------------------------------------------
+    //! @brief      Constructs a new instance.
+    //!
+    //! @param[in]  async  The async facade of the device (must outlive us)
+    //--------------------------------------------------------------------------
+    CNetMdCoro(CNetMdAsync& async) : mAsync(async)
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      run any job
+    //!
+    //! @param[in]  f     callable taking CNetMdApi&
+    //! @param[in]  prio  The priority
+    //!
+    //! @return     awaitable for the result of f
+    //--------------------------------------------------------------------------
+    template<typename F>
+    CNetMdAwaiter<std::decay_t<F>> run(F&& f, Prio prio = Prio::NORMAL)
+    {
+        return CNetMdAwaiter<std::decay_t<F>>(mAsync, std::forward<F>(f), prio);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      request track count
+    //!
+    //! @return     awaitable: < 0 -> NetMdErr; else -> track count
+    //--------------------------------------------------------------------------
+    auto trackCount()
+    {
+        return run([](CNetMdApi& api) { return api.trackCount(); }, Prio::HIGH);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      get disc title
+    //!
+    //! @return     awaitable CoResult with title
+    //--------------------------------------------------------------------------
+    auto discTitle()
+    {
+        return run([](CNetMdApi& api)
+        {
+            CoResult<std::string> res{NETMDERR_NO_ERROR, {}};
+            res.mErr = api.discTitle(res.mValue);
+            return res;
+        }, Prio::HIGH);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track title
+    //!
+    //! @param[in]  track  The track number
+    //!
+    //! @return     awaitable CoResult with title
+    //--------------------------------------------------------------------------
+    auto trackTitle(uint16_t track)
+    {
+        return run([track](CNetMdApi& api)
+        {
+            CoResult<std::string> res{NETMDERR_NO_ERROR, {}};
+            res.mErr = api.trackTitle(track, res.mValue);
+            return res;
+        }, Prio::HIGH);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track time
+    //!
+    //! @param[in]  track  The track number
+    //!
+    //! @return     awaitable CoResult with track time
+    //--------------------------------------------------------------------------
+    auto trackTime(int track)
+    {
+        return run([track](CNetMdApi& api)
+        {
+            CoResult<TrackTime> res{NETMDERR_NO_ERROR, {}};
+            res.mErr = api.trackTime(track, res.mValue);
+            return res;
+        }, Prio::HIGH);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      get disc snapshot
+    //!
+    //! @param[in]  refresh  force re-read from device
+    //!
+    //! @return     awaitable CoResult with disc snapshot
+    //--------------------------------------------------------------------------
+    auto discSnapshot(bool refresh = false)
+    {
+        return run([refresh](CNetMdApi& api)
+        {
+            CoResult<DiscSnapshot> res{NETMDERR_NO_ERROR, {}};
+            res.mErr = api.discSnapshot(res.mValue, refresh);
+            return res;
+        });
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      send audio file to device
+    //!
+    //! @param[in]  filename  The filename
+    //! @param[in]  title     The title
+    //! @param[in]  otf       on the fly encoding format
+    //!
+    //! @return     awaitable NetMdErr
+    //--------------------------------------------------------------------------
+    auto sendAudioFile(const std::string& filename, const std::string& title, DiskFormat otf)
+    {
+        return run([filename, title, otf](CNetMdApi& api)
+        {
+            return api.sendAudioFile(filename, title, otf);
+        }, Prio::LOW);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      finalize TOC through exploit
+    //!
+    //! @param[in]  reset      do a device reset afterwards
+    //! @param[in]  resetWait  time to wait for device after reset
+    //!
+    //! @return     awaitable NetMdErr
+    //--------------------------------------------------------------------------
+    auto finalizeTOC(bool reset = false, uint8_t resetWait = 15)
+    {
+        return run([reset, resetWait](CNetMdApi& api)
+        {
+            return api.finalizeTOC(reset, resetWait);
+        }, Prio::LOW);
+    }
+
+private:
+    CNetMdAsync& mAsync;
+};
+
+} // ~namespace
@@ -31,6 +31,7 @@ CMDiscHeader::CMDiscHeader() : mGroupId(0),
 {
     // add title entry
     mGroups.push_back({mGroupId++, 0, -1, ""});
+    mTrackIdx.emplace(0, TrackRange{0, 0});
 }
 
 //-----------------------------------------------------------------------------
@@ -75,6 +76,7 @@ int CMDiscHeader::fromString(const std::string& header)
     mGroupId = 0;
     constexpr int GROUP_TRACKS = 1;
     constexpr int GROUP_NAME   = 2;
+    TrackIndex idx;
 
     mGroups.clear();
 
@@ -140,7 +142,12 @@ int CMDiscHeader::fromString(const std::string& header)
         }
     }
 
-    if ((ret = sanityCheck(mGroups)) == 0)
+    ret = sanityCheck(mGroups, idx);
+
+    // on error the index holds all groups which passed the check
+    mTrackIdx.swap(idx);
+
+    if (ret == 0)
     {
         listGroups();
     }
@@ -152,63 +159,240 @@ int CMDiscHeader::fromString(const std::string& header)
 //! @brief      check groups / tracks for sanity
 //!
 //! @param[in]  grps  The grps
+//! @param[out] idx   The track index build from the groups
 //!
 //! @return     0 -> all well; -1 -> error
 //-----------------------------------------------------------------------------
-int CMDiscHeader::sanityCheck(const Groups& grps) const
+int CMDiscHeader::sanityCheck(const Groups& grps, TrackIndex& idx) const
 {
-    int last = 0, ret = 0;
+    idx.clear();
 
-    Groups tmpGrps = grps;
+    for(const auto& g : grps)
+    {
+        if (checkRange(idx, g.mFirst, g.mLast) != 0)
+        {
+            return -1;
+        }
 
-    std::sort(tmpGrps.begin(), tmpGrps.end(), 
-        &CMDiscHeader::groupCompare);
+        if (g.mFirst >= 0)
+        {
+            idx.emplace(g.mFirst, TrackRange{(g.mLast == -1) ? g.mFirst : g.mLast, g.mGid});
+        }
+    }
 
-    for(const auto& g : tmpGrps)
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//! @brief      check one track range against a track index
+//!
+//! @param[in]  idx        The track index
+//! @param[in]  first      The first track
+//! @param[in]  last       The last track
+//! @param[in]  ignoreGid  group id to skip in overlap check (optional)
+//!
+//! @return     0 -> all well; -1 -> error
+//-----------------------------------------------------------------------------
+int CMDiscHeader::checkRange(const TrackIndex& idx, int16_t first, int16_t last, int ignoreGid)
+{
+    if ((first == 0) && (last != -1))
     {
-        if ((g.mFirst == 0) && (g.mLast != -1))
+        mLOG(CRITICAL) << "Title group can't have a last entry!";
+        return -1;
+    }
+    else if ((first == -1) && (last != -1))
+    {
+        mLOG(CRITICAL) << "An empty group can't have a last entry!";
+        return -1;
+    }
+    else if ((first > last) && (last != -1))
+    {
+        mLOG(CRITICAL) << "First track number can't be larger than last track number!";
+        return -1;
+    }
+    else if (first > 0)
+    {
+        // the nearest range starting at or before our last track
+        // is the only one which might overlap
+        auto it = idx.upper_bound((last == -1) ? first : last);
+
+        while (it != idx.begin())
         {
-            mLOG(CRITICAL) << "Title group can't have a last entry!";
-            ret = -1;
+            --it;
+
+            if (it->second.mGid == ignoreGid)
+            {
+                continue;
+            }
+
+            if (it->second.mLast >= first)
+            {
+                mLOG(CRITICAL) << "Some groups share the same track numbers!";
+                return -1;
+            }
             break;
         }
-        else if ((g.mFirst == -1) && (g.mLast != -1))
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//! @brief      find group by group id
+//!
+//! @param[in]  gid   The group id
+//!
+//! @return     iterator to group or mGroups.end()
+//-----------------------------------------------------------------------------
+Groups::iterator CMDiscHeader::findGroup(int gid)
+{
+    // group ids are given in ascending order, so mGroups is sorted by id
+    auto it = std::lower_bound(mGroups.begin(), mGroups.end(), gid,
+        [](const Group& g, int id) { return g.mGid < id; });
+
+    if ((it != mGroups.end()) && (it->mGid == gid))
+    {
+        return it;
+    }
+
+    return mGroups.end();
+}
+
+//-----------------------------------------------------------------------------
+//! @brief      find group of a track
+//!
+//! @param[in]  track  The track
+//!
+//! @return     iterator to track index entry or mTrackIdx.end()
+//-----------------------------------------------------------------------------
+CMDiscHeader::TrackIndex::const_iterator CMDiscHeader::findTrack(int16_t track) const
+{
+    auto it = mTrackIdx.upper_bound(track);
+
+    if (it != mTrackIdx.begin())
+    {
+        --it;
+        if (track <= it->second.mLast)
         {
-            mLOG(CRITICAL) << "An empty group can't have a last entry!";
-            ret = -1;
-            break;
+            return it;
+        }
+    }
+
+    return mTrackIdx.end();
+}
+
+//-----------------------------------------------------------------------------
+//! @brief      remove a track and move down all following tracks
+//!
+//! @param[in]  track  The track number
+//! @param[in]  gid    The group id; -1 for all groups
+//!
+//! @return     0 -> ok; -1 -> error
+//-----------------------------------------------------------------------------
+int CMDiscHeader::removeTrack(int16_t track, int gid)
+{
+    // new first / last track for every group; first == -2 marks removed groups
+    std::vector<std::pair<int16_t, int16_t>> ranges;
+    TrackIndex idx;
+    int16_t first, last;
+    bool changed = false;
+
+    ranges.reserve(mGroups.size());
+
+    for (const auto& g : mGroups)
+    {
+        first = g.mFirst;
+        last  = (g.mLast == -1) ? first : g.mLast;
+
+        if (((gid == -1) || (g.mGid == gid)) && (track >= first) && (track <= last))
+        {
+            changed = true;
+
+            if (--last < first)
+            {
+                // erase empty group
+                ranges.emplace_back(-2, -1);
+                continue;
+            }
         }
-        else if ((g.mFirst > g.mLast) && (g.mLast != -1))
+        else if (((gid == -1) || (g.mGid > gid)) && (first > track))
         {
-            mLOG(CRITICAL) << "First track number can't be larger than last track number!";
-            ret = -1;
-            break;
+            changed = true;
+            first --;
+            last  --;
         }
-        else if ((g.mFirst > 0) && (g.mFirst <= last))
+
+        if (first == last)
         {
-            mLOG(CRITICAL) << "Some groups share the same track numbers!";
-            ret = -1;
-            break;
+            last = -1;
+        }
+
+        // validate new range against the ranges we have so far
+        if (checkRange(idx, first, last) != 0)
+        {
+            return -1;
+        }
+
+        if (first >= 0)
+        {
+            idx.emplace(first, TrackRange{(last == -1) ? first : last, g.mGid});
         }
 
-        last  = (g.mLast == -1) ? g.mFirst : g.mLast;
+        ranges.emplace_back(first, last);
     }
 
-    return ret;
+    if (!changed)
+    {
+        return -1;
+    }
+
+    size_t i = 0;
+    for (auto it = mGroups.begin(); it != mGroups.end(); i++)
+    {
+        if (ranges[i].first == -2)
+        {
+            it = mGroups.erase(it);
+            continue;
+        }
+
+        it->mFirst = ranges[i].first;
+        it->mLast  = ranges[i].second;
+        it ++;
+    }
+
+    mTrackIdx.swap(idx);
+    return 0;
 }
 
 //-----------------------------------------------------------------------------
-//! @brief      compare function used to sort groups in header
-//!
-//! @param[in]  a     group a
-//! @param[in]  b     group b
+//! @brief      get groups in header order (title, sorted groups, empty groups)
 //!
-//! @return     true if a less b
+//! @param[out] refs  The group references
 //-----------------------------------------------------------------------------
-bool CMDiscHeader::groupCompare(const Group& a, const Group& b)
+void CMDiscHeader::sortedGroups(GroupRefs& refs) const
 {
-    // empty groups (first == -1) must be last
-    return ((a.mFirst < b.mFirst) && (a.mFirst != -1));
+    refs.clear();
+    refs.reserve(mGroups.size());
+
+    for (const auto& r : mTrackIdx)
+    {
+        auto it = std::lower_bound(mGroups.cbegin(), mGroups.cend(), r.second.mGid,
+            [](const Group& g, int id) { return g.mGid < id; });
+
+        if (it != mGroups.cend())
+        {
+            refs.push_back(&*it);
+        }
+    }
+
+    // empty groups must be last
+    for (const auto& g : mGroups)
+    {
+        if (g.mFirst < 0)
+        {
+            refs.push_back(&g);
+        }
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -219,6 +403,7 @@ bool CMDiscHeader::groupCompare(const Group& a, const Group& b)
 std::string CMDiscHeader::toString()
 {
     std::ostringstream oss;
+    GroupRefs          refs;
 
     if (mpCStringHeader != nullptr)
     {
@@ -226,40 +411,29 @@ std::string CMDiscHeader::toString()
         mpCStringHeader = nullptr;
     }
 
-    Groups tmpGrps = mGroups;
+    const Group& title = mGroups.at(0);
 
-    Group& title = tmpGrps.at(0);
-
-    if (title.mFirst == 0)
+    if ((title.mFirst == 0) && (mGroups.size() == 1))
     {
-        if (tmpGrps.size() == 1)
-        {
-            mpCStringHeader = strdup(title.mName.c_str());
-            return title.mName;
-        }
-        else
-        {
-            oss << "0;" << title.mName << "//";
-            tmpGrps.erase(tmpGrps.begin());
-        }
+        mpCStringHeader = strdup(title.mName.c_str());
+        return title.mName;
     }
 
-    std::sort(tmpGrps.begin(), tmpGrps.end(), 
-        &CMDiscHeader::groupCompare);
+    sortedGroups(refs);
 
-    for (const auto& g : tmpGrps)
+    for (const auto& g : refs)
     {
-        if (g.mFirst != -1)
+        if (g->mFirst != -1)
         {
-            oss << g.mFirst;
+            oss << g->mFirst;
         }
 
-        if (g.mLast != -1)
+        if (g->mLast != -1)
         {
-            oss << "-" << g.mLast;
+            oss << "-" << g->mLast;
         }
 
-        oss << ";" << g.mName << "//";
+        oss << ";" << g->mName << "//";
     }
 
     mpCStringHeader = strdup(oss.str().c_str());
@@ -278,13 +452,15 @@ std::string CMDiscHeader::toString()
 //-----------------------------------------------------------------------------
 int CMDiscHeader::addGroup(const std::string& name, int16_t first, int16_t last)
 {
-    Groups tmpGrps = mGroups;
-    tmpGrps.push_back({mGroupId++, first, last, name});
-
-    if (sanityCheck(tmpGrps) == 0)
+    if (checkRange(mTrackIdx, first, last) == 0)
     {
         mLOG(DEBUG) << "Sanity check for 'addGroup()' successful!";
-        mGroups = tmpGrps;
+        mGroups.push_back({mGroupId++, first, last, name});
+
+        if (first >= 0)
+        {
+            mTrackIdx.emplace(first, TrackRange{(last == -1) ? first : last, mGroupId - 1});
+        }
         return mGroupId - 1;
     }
     else
@@ -345,45 +521,59 @@ void CMDiscHeader::listGroups() const
 //-----------------------------------------------------------------------------
 int CMDiscHeader::addTrackToGroup(int gid, int16_t track)
 {
-    Groups tmpGrps = mGroups;
-    int16_t first, last;
-    bool changed = false;
+    Groups::iterator it = findGroup(gid);
+    int16_t first, last, newFirst, newLast;
 
-    for (auto& g : tmpGrps)
+    if (it == mGroups.end())
     {
-        if (g.mGid == gid)
-        {
-            if ((g.mFirst == -1) && (g.mLast == -1))
-            {
-                g.mFirst = track;
-                changed  = true;
-                break;
-            }
+        return -1;
+    }
 
-            first = g.mFirst;
-            last  = (g.mLast == -1) ? first : g.mLast;
+    if ((it->mFirst == -1) && (it->mLast == -1))
+    {
+        newFirst = track;
+        newLast  = -1;
+    }
+    else
+    {
+        first = it->mFirst;
+        last  = (it->mLast == -1) ? first : it->mLast;
 
-            if ((first - track) == 1)
-            {
-                g.mFirst = track;
-                changed  = true;
-            }
-            else if ((track - last) == 1)
-            {
-                g.mLast = track;
-                changed  = true;
-            }
-            break;
+        if ((first - track) == 1)
+        {
+            newFirst = track;
+            newLast  = last;
+        }
+        else if ((track - last) == 1)
+        {
+            newFirst = first;
+            newLast  = track;
+        }
+        else
+        {
+            return -1;
         }
     }
 
-    if (changed && (sanityCheck(tmpGrps) == 0))
+    if (checkRange(mTrackIdx, newFirst, newLast, gid) != 0)
     {
-        mGroups = tmpGrps;
-        return 0;
+        return -1;
     }
 
-    return -1;
+    if (it->mFirst >= 0)
+    {
+        mTrackIdx.erase(it->mFirst);
+    }
+
+    it->mFirst = newFirst;
+    it->mLast  = newLast;
+
+    if (newFirst >= 0)
+    {
+        mTrackIdx.emplace(newFirst, TrackRange{(newLast == -1) ? newFirst : newLast, gid});
+    }
+
+    return 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -396,124 +586,166 @@ int CMDiscHeader::addTrackToGroup(int gid, int16_t track)
 //-----------------------------------------------------------------------------
 int CMDiscHeader::delTrackFromGroup(int gid, int16_t track)
 {
-    Groups tmpGrps = mGroups;
+    Groups::iterator it = findGroup(gid);
     int16_t first, last;
-    bool changed = false;
 
-    Groups::iterator it;
-    for (it = tmpGrps.begin(); it != tmpGrps.end();)
+    if (it == mGroups.end())
     {
-        first   = it->mFirst;
-        last    = (it->mLast == -1) ? first : it->mLast;
-        
-        if (it->mGid == gid)
-        {
-            if ((track >= first) && (track <= last))
-            {
-                changed = true;
+        return -1;
+    }
 
-                last --;
+    first = it->mFirst;
+    last  = (it->mLast == -1) ? first : it->mLast;
 
-                if (last < first)
-                {
-                    // erase empty group
-                    it = tmpGrps.erase(it);
-                    continue;
-                }
+    if ((track < first) || (track > last))
+    {
+        // track not found in group -> no change!
+        return -1;
+    }
 
-                if (first == last)
-                {
-                    last = -1;
-                }
+    return removeTrack(track, gid);
+}
 
-                it->mLast = last;
-            }
-            else
-            {
-                // track not found in group -> no change!
-                break;
-            }
+//-----------------------------------------------------------------------------
+//! @brief      remove a track
+//!
+//! @param[in]  track  The track number
+//!
+//! @return     0 -> ok; -1 -> error
+//-----------------------------------------------------------------------------
+int CMDiscHeader::delTrack(int16_t track)
+{
+    return removeTrack(track, -1);
+}
+
+//-----------------------------------------------------------------------------
+//! @brief      insert a track; following tracks move up, a group holding
+//!             the track before grows by the new track.
+//!
+//! @param[in]  track  The new track number
+//!
+//! @return     0 -> ok; -1 -> error
+//-----------------------------------------------------------------------------
+int CMDiscHeader::insertTrack(int16_t track)
+{
+    Groups grps = mGroups;
+    TrackIndex idx;
+
+    if (track < 1)
+    {
+        return -1;
+    }
+
+    for (auto& g : grps)
+    {
+        // skip title and empty groups
+        if (g.mFirst < 1)
+        {
+            continue;
         }
-        else if ((it->mGid > gid) && (first > track))
+
+        int16_t last = (g.mLast == -1) ? g.mFirst : g.mLast;
+
+        if (g.mFirst >= track)
         {
-            changed = true;
-            it->mFirst --;
-            if (last != -1)
-            {
-                it->mLast --;
-            }
+            g.mFirst ++;
+            last ++;
         }
-        it ++;
+        else if (last >= (track - 1))
+        {
+            last ++;
+        }
+
+        g.mLast = (last == g.mFirst) ? -1 : last;
     }
 
-    if (changed && (sanityCheck(tmpGrps) == 0))
+    if (sanityCheck(grps, idx) != 0)
     {
-        mGroups = tmpGrps;
-        return 0;
+        return -1;
     }
 
-    return -1;
+    mGroups.swap(grps);
+    mTrackIdx.swap(idx);
+    return 0;
 }
 
 //-----------------------------------------------------------------------------
-//! @brief      remove a track
+//! @brief      apply a new track order to the group ranges. Tracks follow
+//!             their group; if a group's tracks aren't contiguous anymore,
+//!             the group keeps its longest run, all other tracks of
+//!             that group become ungrouped.
 //!
-//! @param[in]  track  The track number
+//! @param[in]  order  old track numbers in new order (order[0] -> track 1)
 //!
 //! @return     0 -> ok; -1 -> error
 //-----------------------------------------------------------------------------
-int CMDiscHeader::delTrack(int16_t track)
+int CMDiscHeader::reorderTracks(const std::vector<int16_t>& order)
 {
-    Groups tmpGrps = mGroups;
-    int16_t first, last;
-    bool changed = false;
+    // old track number -> new track number
+    std::map<int16_t, int16_t> newPos;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        if ((order[i] < 1) || !newPos.emplace(order[i], static_cast<int16_t>(i + 1)).second)
+        {
+            mLOG(CRITICAL) << "Invalid track order!";
+            return -1;
+        }
+    }
 
-    Groups::iterator it;
+    Groups grps = mGroups;
+    TrackIndex idx;
 
-    for (it = tmpGrps.begin(); it != tmpGrps.end();)
+    for (auto& g : grps)
     {
-        first   = it->mFirst;
-        last    = (it->mLast == -1) ? first : it->mLast;
-
-        if ((track >= first) && (track <= last))
+        if (g.mFirst <= 0)
         {
-            changed = true;
+            // title or empty group
+            continue;
+        }
 
-            last --;
+        int16_t last = (g.mLast == -1) ? g.mFirst : g.mLast;
+        std::vector<int16_t> pos;
 
-            if (last < first)
+        for (int16_t t = g.mFirst; t <= last; t++)
+        {
+            std::map<int16_t, int16_t>::const_iterator cit = newPos.find(t);
+            if (cit == newPos.cend())
             {
-                // erase empty group
-                it = tmpGrps.erase(it);
-                continue;
+                mLOG(CRITICAL) << "Track " << t << " is missing in new order!";
+                return -1;
             }
+            pos.push_back(cit->second);
+        }
 
-            if (first == last)
-            {
-                last = -1;
-            }
+        std::sort(pos.begin(), pos.end());
 
-            it->mLast = last;
-        }
-        else if (first > track)
+        // longest run of contiguous track numbers
+        size_t runStart = 0, bestStart = 0, bestLen = 1;
+        for (size_t i = 1; i <= pos.size(); i++)
         {
-            changed = true;
-            it->mFirst --;
-            if (last != -1)
+            if ((i == pos.size()) || (pos[i] != (pos[i - 1] + 1)))
             {
-                it->mLast --;
+                if ((i - runStart) > bestLen)
+                {
+                    bestStart = runStart;
+                    bestLen   = i - runStart;
+                }
+                runStart = i;
             }
         }
-        it ++;
+
+        g.mFirst = pos[bestStart];
+        g.mLast  = (bestLen > 1) ? pos[bestStart + bestLen - 1] : -1;
     }
 
-    if (changed && (sanityCheck(tmpGrps) == 0))
+    if (sanityCheck(grps, idx) != 0)
     {
-        mGroups = tmpGrps;
-        return 0;
+        return -1;
     }
 
-    return -1;
+    mGroups.swap(grps);
+    mTrackIdx.swap(idx);
+    return 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -525,24 +757,24 @@ int CMDiscHeader::delTrack(int16_t track)
 //-----------------------------------------------------------------------------
 int CMDiscHeader::delGroup(int gid)
 {
-    int ret = -1;
+    Groups::iterator it = findGroup(gid);
 
     listGroups();
 
-    Groups::const_iterator cit;
+    if (it == mGroups.end())
+    {
+        return -1;
+    }
+
+    mLOG(DEBUG) << "Delete group " << it->mGid << ", name: '" << it->mName << "'";
 
-    for (cit = mGroups.cbegin(); cit != mGroups.cend(); cit ++)
+    if (it->mFirst >= 0)
     {
-        if (cit->mGid == gid)
-        {
-            mLOG(DEBUG) << "Delete group " << cit->mGid << ", name: '" << cit->mName << "'";
-            mGroups.erase(cit);
-            ret = 0;
-            break;
-        }
+        mTrackIdx.erase(it->mFirst);
     }
 
-    return ret;
+    mGroups.erase(it);
+    return 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -585,13 +817,12 @@ std::string CMDiscHeader::discTitle()
 //-----------------------------------------------------------------------------
 int CMDiscHeader::renameGroup(int gid, const std::string& title)
 {
-    for (auto& g : mGroups)
+    Groups::iterator it = findGroup(gid);
+
+    if (it != mGroups.end())
     {
-        if (g.mGid == gid)
-        {
-            g.mName = title;
-            return 0;
-        }
+        it->mName = title;
+        return 0;
     }
 
     return -1;
@@ -628,7 +859,6 @@ const char* CMDiscHeader::lastString()
 std::string CMDiscHeader::trackGroup(int16_t track, int16_t* pGid)
 {
     std::string ret;
-    int16_t first, last;
     *pGid = -1;
 
     if (mpLastString != nullptr)
@@ -637,18 +867,18 @@ std::string CMDiscHeader::trackGroup(int16_t track, int16_t* pGid)
         mpLastString = nullptr;
     }
 
-    for (const auto& g : mGroups)
+    TrackIndex::const_iterator cit = findTrack(track);
+
+    if (cit != mTrackIdx.cend())
     {
-        first =  g.mFirst;
-        last  = (g.mLast == -1) ? g.mFirst : g.mLast;
+        Groups::iterator it = findGroup(cit->second.mGid);
 
-        if ((track >= first) && (track <= last))
+        if (it != mGroups.end())
         {
-            ret   = g.mName;
-            *pGid = g.mGid;
+            ret   = it->mName;
+            *pGid = it->mGid;
 
             mpLastString = strdup(ret.c_str());
-            break;
         }
     }
     return ret;
@@ -663,16 +893,11 @@ std::string CMDiscHeader::trackGroup(int16_t track, int16_t* pGid)
 //-----------------------------------------------------------------------------
 int CMDiscHeader::unGroup(int16_t track)
 {
-    int16_t first, last;
-    for (const auto& g : mGroups)
-    {
-        first =  g.mFirst;
-        last  = (g.mLast == -1) ? g.mFirst : g.mLast;
+    TrackIndex::const_iterator cit = findTrack(track);
 
-        if ((track >= first) && (track <= last))
-        {
-            return delTrackFromGroup(g.mGid, track);
-        }
+    if (cit != mTrackIdx.cend())
+    {
+        return delTrackFromGroup(cit->second.mGid, track);
     }
     return -1;
 }
@@ -684,10 +909,17 @@ int CMDiscHeader::unGroup(int16_t track)
 //-----------------------------------------------------------------------------
 Groups CMDiscHeader::groups() const
 {
-    Groups tmpGrps = mGroups;
-    std::sort(tmpGrps.begin(), tmpGrps.end(), 
-        &CMDiscHeader::groupCompare);
-    return tmpGrps;
+    Groups    grps;
+    GroupRefs refs;
+
+    sortedGroups(refs);
+    grps.reserve(refs.size());
+
+    for (const auto& g : refs)
+    {
+        grps.push_back(*g);
+    }
+    return grps;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -21,6 +21,7 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <map>
 #include "netmd_defines.h"
 
 namespace netmd {
@@ -109,6 +110,28 @@ public:
     //-----------------------------------------------------------------------------
     int delTrack(int16_t track);
 
+    //-----------------------------------------------------------------------------
+    //! @brief      insert a track; following tracks move up, a group holding
+    //!             the track before grows by the new track.
+    //!
+    //! @param[in]  track  The new track number
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //-----------------------------------------------------------------------------
+    int insertTrack(int16_t track);
+
+    //-----------------------------------------------------------------------------
+    //! @brief      apply a new track order to the group ranges. Tracks follow
+    //!             their group; if a group's tracks aren't contiguous anymore,
+    //!             the group keeps its longest run, all other tracks of
+    //!             that group become ungrouped.
+    //!
+    //! @param[in]  order  old track numbers in new order (order[0] -> track 1)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //-----------------------------------------------------------------------------
+    int reorderTracks(const std::vector<int16_t>& order);
+
     //-----------------------------------------------------------------------------
     //! @brief      remove a group (included tracks become ungrouped)
     //!
@@ -168,16 +191,6 @@ public:
     //-----------------------------------------------------------------------------
     const char* lastString();
 
-    //-----------------------------------------------------------------------------
-    //! @brief      compare function used to sort groups in header
-    //!
-    //! @param[in]  a     group a
-    //! @param[in]  b     group b
-    //!
-    //! @return     true if a less b
-    //-----------------------------------------------------------------------------
-    static bool groupCompare(const Group& a, const Group& b);
-
     //-----------------------------------------------------------------------------
     //! @brief      ungroup a track
     //!
@@ -195,17 +208,79 @@ public:
     Groups groups() const;
 
 protected:
+    //! track range of one group as stored in the track index
+    struct TrackRange
+    {
+        int16_t mLast;  //!< last track (same as first for single track groups)
+        int     mGid;   //!< group id
+    };
+
+    //! sorted interval index: first track -> track range
+    using TrackIndex = std::map<int16_t, TrackRange>;
+
+    //! list of group pointers in header order
+    using GroupRefs = std::vector<const Group*>;
+
     //-----------------------------------------------------------------------------
     //! @brief      check groups / tracks for sanity
     //!
     //! @param[in]  grps  The grps
+    //! @param[out] idx   The track index build from the groups
     //!
     //! @return     0 -> all well; -1 -> error
     //-----------------------------------------------------------------------------
-    int sanityCheck(const Groups& grps) const;
+    int sanityCheck(const Groups& grps, TrackIndex& idx) const;
+
+    //-----------------------------------------------------------------------------
+    //! @brief      check one track range against a track index
+    //!
+    //! @param[in]  idx        The track index
+    //! @param[in]  first      The first track
+    //! @param[in]  last       The last track
+    //! @param[in]  ignoreGid  group id to skip in overlap check (optional)
+    //!
+    //! @return     0 -> all well; -1 -> error
+    //-----------------------------------------------------------------------------
+    static int checkRange(const TrackIndex& idx, int16_t first, int16_t last, int ignoreGid = -1);
+
+    //-----------------------------------------------------------------------------
+    //! @brief      find group by group id
+    //!
+    //! @param[in]  gid   The group id
+    //!
+    //! @return     iterator to group or mGroups.end()
+    //-----------------------------------------------------------------------------
+    Groups::iterator findGroup(int gid);
+
+    //-----------------------------------------------------------------------------
+    //! @brief      find group of a track
+    //!
+    //! @param[in]  track  The track
+    //!
+    //! @return     iterator to track index entry or mTrackIdx.end()
+    //-----------------------------------------------------------------------------
+    TrackIndex::const_iterator findTrack(int16_t track) const;
+
+    //-----------------------------------------------------------------------------
+    //! @brief      remove a track and move down all following tracks
+    //!
+    //! @param[in]  track  The track number
+    //! @param[in]  gid    The group id; -1 for all groups
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //-----------------------------------------------------------------------------
+    int removeTrack(int16_t track, int gid);
+
+    //-----------------------------------------------------------------------------
+    //! @brief      get groups in header order (title, sorted groups, empty groups)
+    //!
+    //! @param[out] refs  The group references
+    //-----------------------------------------------------------------------------
+    void sortedGroups(GroupRefs& refs) const;
 
 private:
     Groups       mGroups;
+    TrackIndex   mTrackIdx;
     int          mGroupId;
     char*        mpCStringHeader;
     char*        mpLastString;
@@ -29,15 +29,19 @@
 
 #include "log.h"
 #include "CNetMdApi.h"
+#include "CNetMdTOC.h"
+#include "CNetMdUTOC.h"
+#include "CNetMdDevCache.h"
+#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <sstream>
+#include <set>
 #include <sys/types.h>
 #include <unistd.h>
 #include <thread>
 #include <chrono>
 
-/// log configuration
-structlog LOGCFG = {true, true, DEBUG, &std::cout, {}};
-
 namespace netmd {
 
 //--------------------------------------------------------------------------
@@ -45,7 +49,8 @@ namespace netmd {
 //--------------------------------------------------------------------------
 CNetMdApi::CNetMdApi()
     : mpDiscHeader(nullptr), mpNetMd(nullptr), 
-      mpSecure(nullptr), mHotplugCallback(nullptr)
+      mpSecure(nullptr), mHotplugCallback(nullptr),
+      mTOCProgressCallback(nullptr), mSnapshot{}
 {
     mpDiscHeader = new CMDiscHeader;
     mpNetMd      = new CNetMdDev;
@@ -88,8 +93,7 @@ CNetMdApi::~CNetMdApi()
 //--------------------------------------------------------------------------
 void CNetMdApi::setLogLevel(int severity)
 {
-    std::unique_lock<std::mutex> lck(LOGCFG.mtxLog);
-    LOGCFG.level = severity;
+    LOGCFG.level.store(severity, std::memory_order_relaxed);
 }
 
 //--------------------------------------------------------------------------
@@ -103,6 +107,66 @@ void CNetMdApi::setLogStream(std::ostream& os)
     LOGCFG.sout = &os;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      Enables / disables asynchronous logging. Log records are
+//!             written by a background thread, so logging doesn't add
+//!             to the device I/O timing.
+//!
+//! @param[in]  async        true -> log through writer thread
+//! @param[in]  blockIfFull  if the log ring is full: true -> wait;
+//!                          false -> drop the message
+//--------------------------------------------------------------------------
+void CNetMdApi::setLogAsync(bool async, bool blockIfFull)
+{
+    if (async)
+    {
+        AsyncLog::start(blockIfFull ? AsyncLog::BLOCK : AsyncLog::DROP);
+    }
+    else
+    {
+        AsyncLog::stop();
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      Sets the device cache file. Firmware version and patch
+//!             slot contents are remembered per device in this file, so
+//!             that a reconnect doesn't need the full device discovery.
+//!
+//! @param[in]  file  The cache file name (empty -> no cache)
+//--------------------------------------------------------------------------
+void CNetMdApi::setDeviceCache(const std::string& file)
+{
+    CNetMdDevCache::setFile(file);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      enable / disable the USB trace. Every USB exchange is
+//!             recorded with its timing in a ring of the given size;
+//!             enabling drops all recorded events.
+//!
+//! @param[in]  events  The ring size in events (0 -> disable)
+//--------------------------------------------------------------------------
+void CNetMdApi::enableTrace(size_t events)
+{
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    mpNetMd->mTrace.enable(events);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      export the USB trace as Chrome trace JSON (can be opened in
+//!             chrome://tracing or the Perfetto UI)
+//!
+//! @param      os    The stream to write to
+//!
+//! @return     number of exported events
+//--------------------------------------------------------------------------
+size_t CNetMdApi::exportTrace(std::ostream& os)
+{
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    return mpNetMd->mTrace.exportJson(os);
+}
+
 //--------------------------------------------------------------------------
 //! @brief      init libusb hotplug (native or emulation)
 //
@@ -152,12 +216,8 @@ std::string CNetMdApi::getDeviceName() const
 int CNetMdApi::cacheTOC()
 {
     mFLOW(DEBUG);
-    unsigned char request[] = {0x00, 0x18, 0x08, 0x10, 0x18, 0x02, 0x03, 0x00};
-    int ret = mpNetMd->exchange(request, sizeof(request));
-
-    if (ret > 0) ret = NETMDERR_NO_ERROR;
-
-    return ret;
+    mpSecure->dropUTOCImages();
+    return mpNetMd->changeDscrtState(CNetMdDev::Descriptor::audioUTOC1TD, CNetMdDev::DscrtAction::openwrite);
 }
 
 //--------------------------------------------------------------------------
@@ -168,12 +228,8 @@ int CNetMdApi::cacheTOC()
 int CNetMdApi::syncTOC()
 {
     mFLOW(DEBUG);
-    unsigned char request[] = {0x00, 0x18, 0x08, 0x10, 0x18, 0x02, 0x00, 0x00};
-    int ret = mpNetMd->exchange(request, sizeof(request));
-
-    if (ret > 0) ret = NETMDERR_NO_ERROR;
-
-    return ret;
+    mpSecure->dropUTOCImages();
+    return mpNetMd->changeDscrtState(CNetMdDev::Descriptor::audioUTOC1TD, CNetMdDev::DscrtAction::close);
 }
 
 //--------------------------------------------------------------------------
@@ -240,6 +296,7 @@ int CNetMdApi::discFlags()
 int CNetMdApi::eraseDisc()
 {
     unsigned char request[] = {0x00, 0x18, 0x40, 0xff, 0x00, 0x00};
+    invalidateSnapshot();
     int ret = mpNetMd->exchange(request, sizeof(request));
 
     if (ret > 0)
@@ -260,14 +317,27 @@ int CNetMdApi::eraseDisc()
 //--------------------------------------------------------------------------
 int CNetMdApi::trackTime(int trackNo, TrackTime& trackTime)
 {
-    unsigned char hs[] = {0x00, 0x18, 0x08, 0x10, 0x10, 0x01, 0x01, 0x00};
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    mpNetMd->changeDscrtState(CNetMdDev::Descriptor::audioContentsTD, CNetMdDev::DscrtAction::openread);
+    return readTrackTime(trackNo, trackTime);
+}
 
+//--------------------------------------------------------------------------
+//! @brief      get track time without descriptor handshake
+//!
+//! @param[in]  trackNo    The track no
+//! @param[out] trackTime  The track time
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::readTrackTime(int trackNo, TrackTime& trackTime)
+{
     NetMDResp query, response;
 
     if ((formatQuery("00 1806 02 20 10 01 %>w 30 00 01 00 ff 00 00 00 00 00",
                     {{mWORD(trackNo)}}, query) == 19) && (query != nullptr))
     {
-        mpNetMd->exchange(hs, sizeof(hs));
         if ((mpNetMd->exchange(query.get(), 19, &response) >= 31) && (response != nullptr))
         {
             trackTime.mMinutes   = bcd_to_proper(&response[28], 1) & 0xff;
@@ -296,12 +366,12 @@ int CNetMdApi::rawDiscHeader(std::string& header)
 
     int ret;
     uint16_t total = 1, remaining = 0, read = 0, chunkSz = 0;
-    unsigned char hs1[] = {0x00, 0x18, 0x08, 0x10, 0x10, 0x01, 0x01, 0x00};
 
     NetMDResp request, response;
     const char* format = "00 1806 02 20 18 01 00 00 30 00 0a 00 ff 00 %>w %>w";
 
-    mpNetMd->exchange(hs1, sizeof(hs1));
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    mpNetMd->changeDscrtState(CNetMdDev::Descriptor::audioContentsTD, CNetMdDev::DscrtAction::openread);
 
     while (read < total)
     {
@@ -365,6 +435,10 @@ int CNetMdApi::initDiscHeader()
 {
     std::string head;
 
+    // new device, new disc or changed disc content
+    invalidateSnapshot();
+    mpNetMd->resetDscrtStates();
+
     if (rawDiscHeader(head) == NETMDERR_NO_ERROR)
     {
         return mpDiscHeader->fromString(head);
@@ -422,6 +496,8 @@ int CNetMdApi::writeRawDiscHeader()
         return ret;
     }
 
+    invalidateSnapshot();
+
     tmpStr    = mpDiscHeader->toString();
     contentSz = tmpStr.size();
     content   = tmpStr.c_str();
@@ -430,10 +506,6 @@ int CNetMdApi::writeRawDiscHeader()
 
     NetMDResp request;
 
-    unsigned char hs[]  = {0x00, 0x18, 0x08, 0x10, 0x18, 0x01, 0x01, 0x00};
-    unsigned char hs2[] = {0x00, 0x18, 0x08, 0x10, 0x18, 0x01, 0x00, 0x00};
-    unsigned char hs3[] = {0x00, 0x18, 0x08, 0x10, 0x18, 0x01, 0x03, 0x00};
-
     const char* format = "00 1807 02 20 18 01 00 00 30 00 0a 00 50 00 %>w 00 00 %>w %*";
     NetMDByteVector ba;
     addArrayData(ba, reinterpret_cast<const uint8_t*>(content), contentSz);
@@ -441,16 +513,16 @@ int CNetMdApi::writeRawDiscHeader()
     if (((ret = formatQuery(format, {{mWORD(contentSz)}, {mWORD(old_header_size)}, {ba}},
         request)) > 0) && (request != nullptr))
     {
-        mpNetMd->exchange(hs , sizeof(hs) );
-        mpNetMd->exchange(hs2, sizeof(hs2));
-        mpNetMd->exchange(hs3, sizeof(hs3));
+        std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+        mpNetMd->changeDscrtState(CNetMdDev::Descriptor::discTitleTD, CNetMdDev::DscrtAction::openread);
+        mpNetMd->changeDscrtState(CNetMdDev::Descriptor::discTitleTD, CNetMdDev::DscrtAction::openwrite);
 
         if ((ret = mpNetMd->exchange(request.get(), ret)) > 0)
         {
             ret = NETMDERR_NO_ERROR;
         }
 
-        mpNetMd->exchange(hs2, sizeof(hs2));
+        mpNetMd->changeDscrtState(CNetMdDev::Descriptor::discTitleTD, CNetMdDev::DscrtAction::close);
     }
     else
     {
@@ -471,7 +543,6 @@ int CNetMdApi::writeRawDiscHeader()
 int CNetMdApi::moveTrack(uint16_t from, uint16_t to)
 {
     int ret = 0;
-    unsigned char hs[] = {0x00, 0x18, 0x08, 0x10, 0x10, 0x01, 0x00, 0x00};
 
     const char* format = "00 1843 ff 00 00 20 10 01 %>w 20 10 01 %>w";
 
@@ -479,7 +550,9 @@ int CNetMdApi::moveTrack(uint16_t from, uint16_t to)
 
     if (((ret = formatQuery(format, {{from}, {to}}, query)) == 16) && (query != nullptr))
     {
-        mpNetMd->exchange(hs, sizeof(hs));
+        invalidateSnapshot();
+        std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+        mpNetMd->changeDscrtState(CNetMdDev::Descriptor::audioContentsTD, CNetMdDev::DscrtAction::close);
         if ((ret = mpNetMd->exchange(query.get(), ret)) > 0)
         {
             ret = NETMDERR_NO_ERROR;
@@ -493,6 +566,132 @@ int CNetMdApi::moveTrack(uint16_t from, uint16_t to)
     return ret;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      reorder all tracks with the fewest possible moves. Tracks
+//!             which are part of the longest increasing subsequence of
+//!             newOrder stay where they are, all others are moved once.
+//!
+//! @param[in]  newOrder  old track numbers in new order
+//!                       (newOrder[0] -> becomes track 0)
+//!
+//! @return     NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::reorderTracks(const std::vector<uint16_t>& newOrder)
+{
+    int ret = NETMDERR_NO_ERROR;
+    const size_t n = newOrder.size();
+
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+
+    // must be a permutation of all tracks
+    std::vector<bool> seen(n, false);
+    if ((trackCount() != static_cast<int>(n)) || (n == 0))
+    {
+        return NETMDERR_PARAM;
+    }
+
+    for (const auto& t : newOrder)
+    {
+        if ((t >= n) || seen[t])
+        {
+            return NETMDERR_PARAM;
+        }
+        seen[t] = true;
+    }
+
+    // longest increasing subsequence (patience sorting)
+    std::vector<size_t> tails;          // index in newOrder of smallest tail per length
+    std::vector<int> prev(n, -1);       // predecessor index in newOrder
+    for (size_t i = 0; i < n; i++)
+    {
+        auto it = std::lower_bound(tails.begin(), tails.end(), newOrder[i],
+                                   [&newOrder](size_t idx, uint16_t val) { return newOrder[idx] < val; });
+
+        if (it != tails.begin())
+        {
+            prev[i] = static_cast<int>(*(it - 1));
+        }
+
+        if (it == tails.end())
+        {
+            tails.push_back(i);
+        }
+        else
+        {
+            *it = i;
+        }
+    }
+
+    std::vector<bool> keep(n, false);
+    for (int i = tails.empty() ? -1 : static_cast<int>(tails.back()); i != -1; i = prev[i])
+    {
+        keep[newOrder[i]] = true;
+    }
+
+    mLOG(DEBUG) << "Reorder " << n << " tracks using " << (n - tails.size()) << " move(s).";
+
+    // current layout: position -> old track number
+    std::vector<uint16_t> cur(newOrder);
+    std::sort(cur.begin(), cur.end());
+
+    bool moved = false;
+    cacheTOC();
+
+    for (size_t i = 0; (i < n) && (ret == NETMDERR_NO_ERROR); i++)
+    {
+        uint16_t track = newOrder[i];
+        if (keep[track])
+        {
+            continue;
+        }
+
+        uint16_t from = std::find(cur.begin(), cur.end(), track) - cur.begin();
+        uint16_t to   = 0;
+
+        // place it right behind its predecessor in the new order
+        if (i > 0)
+        {
+            uint16_t pred = std::find(cur.begin(), cur.end(), newOrder[i - 1]) - cur.begin();
+            to = (from > pred) ? (pred + 1) : pred;
+        }
+
+        if (from != to)
+        {
+            if ((ret = moveTrack(from, to)) == NETMDERR_NO_ERROR)
+            {
+                moved = true;
+                cur.erase(cur.begin() + from);
+                cur.insert(cur.begin() + to, track);
+            }
+        }
+    }
+
+    syncTOC();
+
+    if (moved)
+    {
+        // header uses 1-based track numbers
+        std::vector<int16_t> order;
+        for (const auto& t : (ret == NETMDERR_NO_ERROR) ? newOrder : cur)
+        {
+            order.push_back(static_cast<int16_t>(t + 1));
+        }
+
+        std::string before = mpDiscHeader->toString();
+
+        if ((mpDiscHeader->reorderTracks(order) == 0) && (mpDiscHeader->toString() != before))
+        {
+            int err = writeRawDiscHeader();
+            if (ret == NETMDERR_NO_ERROR)
+            {
+                ret = err;
+            }
+        }
+    }
+
+    return ret;
+}
+
 //--------------------------------------------------------------------------
 //! @brief      Sets the group title.
 //!
@@ -595,35 +794,75 @@ int CNetMdApi::deleteGroup(int group)
 //--------------------------------------------------------------------------
 int CNetMdApi::deleteTrack(uint16_t track)
 {
-    int ret = 0;
+    return deleteTracks({track});
+}
+
+//--------------------------------------------------------------------------
+//! @brief      delete several tracks at once; the group header is
+//!             updated locally and written once
+//!
+//! @param[in]  tracks  The track numbers
+//!
+//! @return     NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::deleteTracks(const std::vector<uint16_t>& tracks)
+{
+    int ret = NETMDERR_NO_ERROR;
+    bool headerChanged = false;
 
-    if (trackCount() > static_cast<int>(track))
+    // descending order, so track numbers of pending deletes stay valid
+    std::set<uint16_t, std::greater<uint16_t>> order(tracks.cbegin(), tracks.cend());
+
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+
+    if (order.empty() || (trackCount() <= static_cast<int>(*order.cbegin())))
+    {
+        return NETMDERR_PARAM;
+    }
+
+    invalidateSnapshot();
+    cacheTOC();
+
+    for (const auto& track : order)
     {
         const char* format = "00 1840 ff 01 00 20 10 01 %>w";
         NetMDResp query;
         if (((ret = formatQuery(format, {{track}}, query)) == 11) && (query != nullptr))
         {
-            cacheTOC();
             if ((ret = mpNetMd->exchange(query.get(), ret)) > 0)
             {
                 mpNetMd->waitForSync();
                 ret = NETMDERR_NO_ERROR;
-            }
-            syncTOC();
 
-            if (ret == NETMDERR_NO_ERROR)
-            {
-                initDiscHeader();
+                // group header uses 1-based track numbers
+                if (mpDiscHeader->delTrack(static_cast<int16_t>(track + 1)) == 0)
+                {
+                    headerChanged = true;
+                }
             }
         }
         else
         {
             ret = NETMDERR_PARAM;
         }
+
+        if (ret != NETMDERR_NO_ERROR)
+        {
+            mLOG(CRITICAL) << "Can't delete track " << (track + 1) << "!";
+            break;
+        }
     }
-    else
+
+    syncTOC();
+
+    // write what we have, even if not all tracks were deleted
+    if (headerChanged)
     {
-        ret = NETMDERR_PARAM;
+        int err = writeRawDiscHeader();
+        if (ret == NETMDERR_NO_ERROR)
+        {
+            ret = err;
+        }
     }
 
     return ret;
@@ -772,11 +1011,136 @@ int CNetMdApi::setTrackTitle(uint16_t trackNo, const std::string& title)
     std::string currTitle;
     uint8_t oldSz = 0;
 
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+
+    // one read is cheaper than checking the snapshot against the disc
     if (trackTitle(trackNo, currTitle) == NETMDERR_NO_ERROR)
     {
         oldSz = currTitle.size();
     }
 
+    invalidateSnapshot();
+    cacheTOC();
+    ret = writeTrackTitle(trackNo, title, oldSz);
+    syncTOC();
+
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      Sets several track titles at once. Old title sizes are
+//!             taken from the cached snapshot if there is one and it
+//!             still matches the disc in the drive (track count, disc
+//!             flags and header); otherwise they are read in one pass
+//!             before writing.
+//!
+//! @param[in]  titles  track number -> title
+//!
+//! @return     NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::setTrackTitles(const std::map<uint16_t, std::string>& titles)
+{
+    int ret = NETMDERR_NO_ERROR;
+    std::map<uint16_t, uint8_t> oldSz;
+
+    if (titles.empty())
+    {
+        return NETMDERR_PARAM;
+    }
+
+    // checking the snapshot costs 3 queries; below that, read directly
+    constexpr size_t SNAP_CHECK_COST = 3;
+
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    bool useSnap = false;
+
+    if (titles.size() > SNAP_CHECK_COST)
+    {
+        std::unique_lock<std::mutex> snapLck(mMtxSnapshot);
+        useSnap = mSnapshot.mValid;
+    }
+
+    if (useSnap)
+    {
+        // MDs carry no disc id - check snapshot against the disc in the drive
+        int         tracks = trackCount();
+        int         flags  = discFlags();
+        std::string head;
+        CMDiscHeader currHdr;
+        bool hdrOk = (rawDiscHeader(head) == NETMDERR_NO_ERROR) && (currHdr.fromString(head) == 0);
+
+        std::unique_lock<std::mutex> snapLck(mMtxSnapshot);
+        if (mSnapshot.mValid && hdrOk
+            && (static_cast<int>(mSnapshot.mTracks.size()) == tracks)
+            && (mSnapshot.mDiscFlags == flags)
+            && (mSnapshot.mDiscTitle == currHdr.discTitle()))
+        {
+            for (const auto& t : mSnapshot.mTracks)
+            {
+                if ((t.mNo < tracks) && (titles.find(t.mNo) != titles.cend()))
+                {
+                    oldSz[t.mNo] = t.mTitle.size();
+                }
+            }
+        }
+    }
+
+    // read missing old titles before the TOC is cached
+    for (const auto& t : titles)
+    {
+        if (oldSz.find(t.first) == oldSz.cend())
+        {
+            std::string currTitle;
+            oldSz[t.first] = (trackTitle(t.first, currTitle) == NETMDERR_NO_ERROR) ? currTitle.size() : 0;
+        }
+    }
+
+    cacheTOC();
+
+    for (const auto& t : titles)
+    {
+        if ((ret = writeTrackTitle(t.first, t.second, oldSz[t.first])) != NETMDERR_NO_ERROR)
+        {
+            break;
+        }
+    }
+
+    syncTOC();
+
+    if (ret == NETMDERR_NO_ERROR)
+    {
+        // keep snapshot up to date instead of re-reading it
+        std::unique_lock<std::mutex> snapLck(mMtxSnapshot);
+        for (auto& t : mSnapshot.mTracks)
+        {
+            std::map<uint16_t, std::string>::const_iterator cit = titles.find(t.mNo);
+            if (cit != titles.cend())
+            {
+                t.mTitle = cit->second;
+            }
+        }
+    }
+    else
+    {
+        invalidateSnapshot();
+    }
+
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write one track title (TOC must be cached by caller)
+//!
+//! @param[in]  trackNo  The track no
+//! @param[in]  title    The title
+//! @param[in]  oldSz    size of the current title
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::writeTrackTitle(uint16_t trackNo, const std::string& title, uint8_t oldSz)
+{
+    int ret;
     NetMDByteVector ba;
     NetMDResp query;
     addArrayData(ba, reinterpret_cast<const uint8_t*>(title.c_str()), title.size());
@@ -791,7 +1155,6 @@ int CNetMdApi::setTrackTitle(uint16_t trackNo, const std::string& title)
 
     if (((ret = formatQuery(format, params, query)) > 0) && (query != nullptr))
     {
-        cacheTOC();
         if (mpNetMd->exchange(query.get(), ret) > 0)
         {
             ret = NETMDERR_NO_ERROR;
@@ -801,14 +1164,12 @@ int CNetMdApi::setTrackTitle(uint16_t trackNo, const std::string& title)
             ret = NETMDERR_PARAM;
             mLOG(CRITICAL) << "exchange() failed.";
         }
-        syncTOC();
     }
     else
     {
         ret = NETMDERR_PARAM;
     }
 
-
     return ret;
 }
 
@@ -825,64 +1186,681 @@ int CNetMdApi::setTrackTitle(uint16_t trackNo, const std::string& title)
 int CNetMdApi::sendAudioFile(const std::string& filename, const std::string& title, DiskFormat otf)
 {
     mFLOW(INFO);
-    return mpSecure->sendAudioTrack(filename, title, otf);
-}
 
-//--------------------------------------------------------------------------
-//! @brief      is on the fly encoding supported by device
-//!
-//! @return     true if so
-//--------------------------------------------------------------------------
-bool CNetMdApi::otfEncodeSupported()
-{
-    return mpNetMd->mDevice.mKnownDev.mOtfEncode;
+    // block the device for the whole transfer; readers
+    // will get the cached disc snapshot meanwhile
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    int ret = mpSecure->sendAudioTrack(filename, title, otf);
+    invalidateSnapshot();
+    return ret;
 }
 
 //--------------------------------------------------------------------------
-//! @brief      get disc capacity
+//! @brief      Sends an album as one gapless recording
 //!
-//! @param      dcap  The buffer for disc capacity
+//! @param[in]  tracks  The album tracks in play order
+//! @param[in]  otf     The disk format
 //!
 //! @return     NetMdErr
 //! @see        NetMdErr
 //--------------------------------------------------------------------------
-int CNetMdApi::discCapacity(DiscCapacity& dcap)
+int CNetMdApi::sendAlbum(const AlbumTracks& tracks, DiskFormat otf)
 {
-    int ret;
-    uint8_t hs[] = {0x00, 0x18, 0x08, 0x10, 0x10, 0x00, 0x01, 0x00};
-    uint8_t request[] = {0x00, 0x18, 0x06, 0x02, 0x10, 0x10,
-                         0x00, 0x30, 0x80, 0x03, 0x00, 0xff,
-                         0x00, 0x00, 0x00, 0x00, 0x00};
-
-    NetMDResp resp;
-    mpNetMd->exchange(hs, sizeof(hs));
+    mFLOW(INFO);
+    std::vector<std::string> files, titles;
 
-    if ((mpNetMd->exchange(request, sizeof(request), &resp) >= 46) && (resp != nullptr))
-    {
-        parse_time(resp.get() + 27, dcap.recorded);
-        parse_time(resp.get() + 34, dcap.total);
-        parse_time(resp.get() + 41, dcap.available);
-        ret = NETMDERR_NO_ERROR;
-    }
-    else
+    for (const auto& t : tracks)
     {
-        ret = NETMDERR_CMD_FAILED;
+        files.push_back(t.mFileName);
+        titles.push_back(t.mTitle);
     }
-    return ret;
+
+    return sendAlbumWave(files, titles, {}, otf);
 }
 
 //--------------------------------------------------------------------------
-//! @brief      get MD track groups
+//! @brief      Sends an album described by a CUE sheet
 //!
-//! @return     vector of group structures
+//! @param[in]  cueFile  The CUE sheet
+//! @param[in]  otf      The disk format
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
 //--------------------------------------------------------------------------
-Groups CNetMdApi::groups()
+int CNetMdApi::sendCueAlbum(const std::string& cueFile, DiskFormat otf)
 {
-    return mpDiscHeader->groups();
-}
+    mFLOW(INFO);
+    std::ifstream cue(cueFile);
 
-//--------------------------------------------------------------------------
-//! @brief      Reads an utoc sector.
+    if (!cue)
+    {
+        mLOG(CRITICAL) << "Can't open CUE sheet " << cueFile;
+        return NETMDERR_PARAM;
+    }
+
+    std::string              wave, line;
+    std::vector<std::string> titles;
+    std::vector<uint64_t>    starts;
+    std::string              dir = cueFile.substr(0, cueFile.find_last_of("/\\") + 1);
+
+    while (std::getline(cue, line))
+    {
+        std::istringstream iss(line);
+        std::string        cmd;
+        iss >> cmd;
+
+        // value might be quoted and contain spaces
+        auto value = [&]()
+        {
+            size_t first = line.find('"');
+            size_t last  = line.rfind('"');
+            std::string v;
+
+            if ((first != std::string::npos) && (last > first))
+            {
+                v = line.substr(first + 1, last - first - 1);
+            }
+            else
+            {
+                iss >> v;
+            }
+            return v;
+        };
+
+        if (cmd == "FILE")
+        {
+            if (!wave.empty())
+            {
+                mLOG(CRITICAL) << "CUE sheets with more than one file aren't supported!";
+                return NETMDERR_NOT_SUPPORTED;
+            }
+
+            wave = value();
+
+            if ((wave.find('/') != 0) && (wave.find(':') != 1))
+            {
+                wave = dir + wave;
+            }
+        }
+        else if (cmd == "TRACK")
+        {
+            titles.push_back("");
+            starts.push_back(UINT64_MAX);
+        }
+        else if ((cmd == "TITLE") && !titles.empty())
+        {
+            titles.back() = value();
+        }
+        else if ((cmd == "INDEX") && !starts.empty())
+        {
+            int idx = 0, mm = 0, ss = 0, ff = 0;
+            char sep;
+            iss >> idx >> mm >> sep >> ss >> sep >> ff;
+
+            if (idx == 1)
+            {
+                // 75 CD frames per second, 588 samples per frame
+                starts.back() = ((static_cast<uint64_t>(mm) * 60 + ss) * 75 + ff) * 588;
+            }
+        }
+    }
+
+    if (wave.empty() || titles.empty()
+        || (std::find(starts.begin(), starts.end(), UINT64_MAX) != starts.end()))
+    {
+        mLOG(CRITICAL) << "Invalid CUE sheet " << cueFile;
+        return NETMDERR_PARAM;
+    }
+
+    // a hidden pregap belongs to the first track
+    starts.front() = 0;
+
+    return sendAlbumWave({wave}, titles, starts, otf);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      send WAVE files as one track and split it in the UTOC
+//!
+//! @param[in]  files   The PCM WAVE files
+//! @param[in]  titles  The track titles
+//! @param[in]  starts  The track start positions in samples; if empty
+//!                     every file is one track
+//! @param[in]  otf     The disk format
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::sendAlbumWave(const std::vector<std::string>& files, const std::vector<std::string>& titles,
+                             const std::vector<uint64_t>& starts, DiskFormat otf)
+{
+    mFLOW(DEBUG);
+
+    if (!tocManipSupported())
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    uint8_t*              data   = nullptr;
+    size_t                dataSz = 0;
+    std::vector<uint64_t> samples;
+    std::vector<uint64_t> pos    = starts;
+
+    int ret = mpSecure->joinWaveFiles(files, &data, dataSz, samples);
+
+    if (ret != NETMDERR_NO_ERROR)
+    {
+        return ret;
+    }
+
+    if (pos.empty())
+    {
+        uint64_t done = 0;
+        for (const auto& s : samples)
+        {
+            pos.push_back(done);
+            done += s;
+        }
+    }
+
+    if (titles.empty() || (pos.size() != titles.size()))
+    {
+        delete [] data;
+        return NETMDERR_PARAM;
+    }
+
+    // block the device for transfer and UTOC edit
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    uint16_t trackNo = 0;
+
+    // data is deleted by sendAudioData()
+    ret = mpSecure->sendAudioData(data, dataSz, titles.at(0), otf, trackNo);
+    invalidateSnapshot();
+
+    if (ret != NETMDERR_NO_ERROR)
+    {
+        return ret;
+    }
+
+    CNetMdUTOC utoc;
+
+    if ((ret = loadUTOC(utoc)) != NETMDERR_NO_ERROR)
+    {
+        return ret;
+    }
+
+    int                track  = trackNo + 1;
+    CNetMdUTOC::Ranges ranges = utoc.trackRanges(track);
+    std::time_t        now    = std::time(nullptr);
+
+    if (ranges.empty())
+    {
+        mLOG(CRITICAL) << "Album track " << track << " not found in UTOC!";
+        return NETMDERR_OTHER;
+    }
+
+    uint64_t spg = CSG::groupSamples(ranges.at(0).mMode);
+
+    // Split from the back, so the split position is always
+    // relative to the start of the recorded track.
+    for (size_t i = pos.size() - 1; i > 0; i--)
+    {
+        uint32_t at = static_cast<uint32_t>((pos.at(i) + spg / 2) / spg);
+
+        if (utoc.splitTrack(track, at) != 0)
+        {
+            mLOG(CRITICAL) << "Can't split album track at sound group " << at << "!";
+            return NETMDERR_OTHER;
+        }
+    }
+
+    for (size_t i = 0; i < titles.size(); i++)
+    {
+        if ((utoc.setTitle(track + i, titles.at(i)) != 0)
+            || (utoc.setTStamp(track + i, now) != 0))
+        {
+            return NETMDERR_OTHER;
+        }
+    }
+
+    // unlocks the device before the TOC is finalized
+    return commitUTOC(utoc, lck);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      split a track through UTOC edit
+//!
+//! @param[in]  track   The track number (starting with 0)
+//! @param[in]  groups  The split position in sound groups from track start
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::splitTrack(uint16_t track, uint32_t groups)
+{
+    mFLOW(INFO);
+
+    if (!tocManipSupported())
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    CNetMdUTOC utoc;
+    int ret = loadUTOC(utoc);
+
+    if (ret != NETMDERR_NO_ERROR)
+    {
+        return ret;
+    }
+
+    if (utoc.splitTrack(track + 1, groups) != 0)
+    {
+        mLOG(CRITICAL) << "Can't split track " << track << " at sound group " << groups << "!";
+        return NETMDERR_PARAM;
+    }
+
+    // new track joins the group of the split track; the disc
+    // header is changed on a copy until the UTOC is committed
+    std::string  oldHdr = mpDiscHeader->toString();
+    CMDiscHeader hdr;
+    hdr.fromString(oldHdr);
+
+    if (hdr.insertTrack(track + 2) != 0)
+    {
+        mLOG(CRITICAL) << "Can't insert track " << track + 1 << " into disc header!";
+        return NETMDERR_OTHER;
+    }
+
+    std::string newHdr = hdr.toString();
+
+    if ((newHdr != oldHdr) && (utoc.setTitle(0, newHdr) != 0))
+    {
+        mLOG(CRITICAL) << "Can't store disc header in UTOC!";
+        return NETMDERR_OTHER;
+    }
+
+    if ((ret = commitUTOC(utoc, lck)) == NETMDERR_NO_ERROR)
+    {
+        mpDiscHeader->fromString(newHdr);
+    }
+
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      join two tracks through UTOC edit
+//!
+//! @param[in]  first   The first track number (starting with 0)
+//! @param[in]  second  The second track number (starting with 0)
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::joinTracks(uint16_t first, uint16_t second)
+{
+    mFLOW(INFO);
+
+    if (!tocManipSupported())
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    CNetMdUTOC utoc;
+    int ret = loadUTOC(utoc);
+
+    if (ret != NETMDERR_NO_ERROR)
+    {
+        return ret;
+    }
+
+    if (utoc.joinTracks(first + 1, second + 1) != 0)
+    {
+        return NETMDERR_PARAM;
+    }
+
+    // the disc header is changed on a copy until the UTOC is committed
+    std::string  oldHdr = mpDiscHeader->toString();
+    CMDiscHeader hdr;
+    hdr.fromString(oldHdr);
+
+    // delTrack() fails if no group is touched -> check first
+    bool touched = false;
+
+    for (const auto& g : hdr.groups())
+    {
+        if ((g.mFirst > 0) && (std::max(g.mFirst, g.mLast) >= second + 1))
+        {
+            touched = true;
+        }
+    }
+
+    if (touched && (hdr.delTrack(second + 1) != 0))
+    {
+        mLOG(CRITICAL) << "Can't remove track " << second << " from disc header!";
+        return NETMDERR_OTHER;
+    }
+
+    std::string newHdr = hdr.toString();
+
+    if ((newHdr != oldHdr) && (utoc.setTitle(0, newHdr) != 0))
+    {
+        mLOG(CRITICAL) << "Can't store disc header in UTOC!";
+        return NETMDERR_OTHER;
+    }
+
+    if ((ret = commitUTOC(utoc, lck)) == NETMDERR_NO_ERROR)
+    {
+        mpDiscHeader->fromString(newHdr);
+    }
+
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      read UTOC sectors into UTOC model (device must be locked)
+//!
+//! @param[out] utoc  The UTOC model
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::loadUTOC(CNetMdUTOC& utoc)
+{
+    for (const auto s : {POS_ADDR, HW_TITLES, TSTAMPS})
+    {
+        if (utoc.load(s, mpSecure->readUTOCSector(s)) != 0)
+        {
+            mLOG(CRITICAL) << "Can't read UTOC sector " << static_cast<int>(s) << "!";
+            return NETMDERR_CMD_FAILED;
+        }
+    }
+    return NETMDERR_NO_ERROR;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write changed UTOC sectors with locked device, then unlock
+//!             and finalize TOC (includes device reset). The lock must
+//!             be the only one held, since hotplug needs the device
+//!             mutex to re-open the device after the reset.
+//!
+//! @param[in]  utoc  The UTOC model
+//! @param      lck   The device lock (unlocked on return)
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::commitUTOC(CNetMdUTOC& utoc, std::unique_lock<std::recursive_mutex>& lck)
+{
+    invalidateSnapshot(true);
+
+    for (const auto s : {POS_ADDR, HW_TITLES, TSTAMPS})
+    {
+        if (utoc.dirty(s) && (mpSecure->writeUTOCSector(s, utoc.store(s)) != NETMDERR_NO_ERROR))
+        {
+            mLOG(CRITICAL) << "Can't write UTOC sector " << static_cast<int>(s) << "!";
+            lck.unlock();
+            return NETMDERR_CMD_FAILED;
+        }
+    }
+
+    utoc.clearDirty();
+    lck.unlock();
+    return finalizeTOC(true);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      is on the fly encoding supported by device
+//!
+//! @return     true if so
+//--------------------------------------------------------------------------
+bool CNetMdApi::otfEncodeSupported()
+{
+    return mpNetMd->mDevice.mKnownDev.mOtfEncode;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get disc capacity
+//!
+//! @param      dcap  The buffer for disc capacity
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::discCapacity(DiscCapacity& dcap)
+{
+    int ret;
+    uint8_t request[] = {0x00, 0x18, 0x06, 0x02, 0x10, 0x10,
+                         0x00, 0x30, 0x80, 0x03, 0x00, 0xff,
+                         0x00, 0x00, 0x00, 0x00, 0x00};
+
+    NetMDResp resp;
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    mpNetMd->changeDscrtState(CNetMdDev::Descriptor::rootTD, CNetMdDev::DscrtAction::openread);
+
+    if ((mpNetMd->exchange(request, sizeof(request), &resp) >= 46) && (resp != nullptr))
+    {
+        parse_time(resp.get() + 27, dcap.recorded);
+        parse_time(resp.get() + 34, dcap.total);
+        parse_time(resp.get() + 41, dcap.available);
+        ret = NETMDERR_NO_ERROR;
+    }
+    else
+    {
+        ret = NETMDERR_CMD_FAILED;
+    }
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get MD track groups
+//!
+//! @return     vector of group structures
+//--------------------------------------------------------------------------
+Groups CNetMdApi::groups()
+{
+    return mpDiscHeader->groups();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get a snapshot of all disc and track meta data
+//!
+//! @param[out] snap     The buffer for the snapshot
+//! @param[in]  refresh  force re-read if true (optional)
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::discSnapshot(DiscSnapshot& snap, bool refresh)
+{
+    mFLOW(DEBUG);
+    std::unique_lock<std::recursive_mutex> devLck(mpNetMd->mMtxDevAcc, std::try_to_lock);
+
+    if (!devLck.owns_lock())
+    {
+        // device is busy (e.g. track upload) -> don't wait, use cache
+        std::unique_lock<std::mutex> lck(mMtxSnapshot);
+
+        if (mSnapshot.mValid)
+        {
+            mLOG(DEBUG) << "Device busy, use cached disc snapshot.";
+            snap = mSnapshot;
+            return NETMDERR_NO_ERROR;
+        }
+
+        mLOG(DEBUG) << "Device busy and no cached disc snapshot available!";
+        return NETMDERR_NOTREADY;
+    }
+
+    if (!refresh)
+    {
+        std::unique_lock<std::mutex> lck(mMtxSnapshot);
+
+        // a changed track count shows a disc change
+        if (mSnapshot.mValid && (static_cast<int>(mSnapshot.mTracks.size()) == trackCount()))
+        {
+            snap = mSnapshot;
+            return NETMDERR_NO_ERROR;
+        }
+    }
+
+    DiscSnapshot tmpSnap{};
+    int ret = readSnapshot(tmpSnap);
+
+    if (ret == NETMDERR_NO_ERROR)
+    {
+        std::unique_lock<std::mutex> lck(mMtxSnapshot);
+        mSnapshot = tmpSnap;
+        snap      = tmpSnap;
+    }
+
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      read all disc and track meta data in one pass
+//!
+//! @param[out] snap  The buffer for the snapshot
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::readSnapshot(DiscSnapshot& snap)
+{
+    mFLOW(DEBUG);
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+
+    int tracks = trackCount();
+    int ret    = NETMDERR_NO_ERROR;
+
+    if (tracks < 0)
+    {
+        return tracks;
+    }
+
+    snap.mValid     = false;
+    snap.mDiscFlags = discFlags();
+    snap.mDiscTitle = mpDiscHeader->discTitle();
+    snap.mGroups    = mpDiscHeader->groups();
+    snap.mTracks.clear();
+
+    // fixed cost UTOC listing, if available
+    if (tocManipSupported() && (utocTrackList(snap.mTracks) == NETMDERR_NO_ERROR)
+        && (static_cast<int>(snap.mTracks.size()) == tracks))
+    {
+        snap.mValid = true;
+        return NETMDERR_NO_ERROR;
+    }
+
+    snap.mTracks.clear();
+    snap.mTracks.reserve(tracks);
+
+    // open audio contents descriptor once for all tracks; it stays open
+    // so following track queries don't need another handshake
+    mpNetMd->changeDscrtState(CNetMdDev::Descriptor::audioContentsTD, CNetMdDev::DscrtAction::openread);
+
+    for (int i = 0; i < tracks; i++)
+    {
+        TrackInfo ti{static_cast<uint16_t>(i), {}, {0, 0, 0}, AudioEncoding::UNKNOWN, 0, TrackProtection::UNKNOWN, 0, 0};
+
+        if ((trackTitle(ti.mNo, ti.mTitle) != NETMDERR_NO_ERROR)
+            || (readTrackTime(ti.mNo, ti.mTime) != NETMDERR_NO_ERROR)
+            || (trackBitRate(ti.mNo, ti.mEncoding, ti.mChannel) != NETMDERR_NO_ERROR)
+            || (trackFlags(ti.mNo, ti.mProtection) != NETMDERR_NO_ERROR))
+        {
+            mLOG(CRITICAL) << "Can't read meta data of track " << (i + 1) << "!";
+            ret = NETMDERR_CMD_FAILED;
+            break;
+        }
+
+        snap.mTracks.push_back(ti);
+    }
+
+    snap.mValid = (ret == NETMDERR_NO_ERROR);
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      list all tracks from UTOC
+//!
+//! @param[out] tracks  The buffer for track information
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdApi::utocTrackList(TrackInfos& tracks)
+{
+    mFLOW(DEBUG);
+    tracks.clear();
+
+    if (!tocManipSupported())
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    std::unique_lock<std::recursive_mutex> lck(mpNetMd->mMtxDevAcc);
+    NetMDByteVector tocData;
+
+    for (const auto s : {POS_ADDR, HW_TITLES, TSTAMPS})
+    {
+        NetMDByteVector sector = mpSecure->readUTOCSector(s);
+
+        if (sector.size() != 2352)
+        {
+            mLOG(CRITICAL) << "Can't read UTOC sector " << static_cast<int>(s) << "!";
+            return NETMDERR_CMD_FAILED;
+        }
+
+        tocData += sector;
+    }
+
+    CNetMdTOC utoc(0, 0, tocData.data());
+    int count = utoc.trackCount();
+
+    for (int i = 1; i <= count; i++)
+    {
+        uint8_t  mode = utoc.trackMode(i);
+        uint32_t ms   = utoc.trackLength(i);
+
+        TrackInfo ti{static_cast<uint16_t>(i - 1), utoc.trackTitle(i),
+                     {static_cast<int>(ms / 60'000), static_cast<int>((ms % 60'000) / 1'000), static_cast<int>((ms % 1'000) / 10)},
+                     AudioEncoding::SP, NETMD_CHANNELS_STEREO, TrackProtection::UNKNOWN, ms, utoc.trackTStamp(i)};
+
+        if (mode & toc::F_SP_MODE)
+        {
+            ti.mChannel = (mode & toc::F_STEREO) ? NETMD_CHANNELS_STEREO : NETMD_CHANNELS_MONO;
+        }
+        else
+        {
+            ti.mEncoding = (mode & toc::F_STEREO) ? AudioEncoding::LP2 : AudioEncoding::LP4;
+        }
+
+        mLOG(DEBUG) << "Track " << i << ": '" << ti.mTitle << "', " << ti.mTime << ", " << ti.mEncoding;
+        tracks.push_back(ti);
+    }
+
+    return NETMDERR_NO_ERROR;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      drop cached disc snapshot
+//--------------------------------------------------------------------------
+void CNetMdApi::invalidateSnapshot(bool keepUTOCImages)
+{
+    {
+        std::unique_lock<std::mutex> lck(mMtxSnapshot);
+        mSnapshot.mValid = false;
+    }
+
+    // any other disc change makes the known UTOC images stale
+    if (!keepUTOCImages)
+    {
+        mpSecure->dropUTOCImages();
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      Reads an utoc sector.
 //!
 //! @param[in]  s     sector number
 //!
@@ -904,6 +1882,7 @@ NetMDByteVector CNetMdApi::readUTOCSector(UTOCSector s)
 //--------------------------------------------------------------------------
 int CNetMdApi::writeUTOCSector(UTOCSector s, const NetMDByteVector& data)
 {
+    invalidateSnapshot(true);
     return mpSecure->writeUTOCSector(s, data);
 }
 
@@ -911,33 +1890,99 @@ int CNetMdApi::writeUTOCSector(UTOCSector s, const NetMDByteVector& data)
 //! @brief      finalize TOC through exploit
 //!
 //! @param[in]  reset      do reset if true (default: false)
-//! @param[in]  resetWait  The optional reset wait time (20 seconds)
+//! @param[in]  resetWait  The optional max. reset wait time (20 seconds)
 //!                        Only needed if reset is true
 //!
+//! @note       With reset, don't call this with locked device mutex;
+//!             hotplug needs it to re-open the device.
+//!
 //! @return     NetMdErr
 //! @see        NetMdErr
 //--------------------------------------------------------------------------
 int CNetMdApi::finalizeTOC(bool reset, uint8_t resetWait)
 {
-    int ret = mpSecure->finalizeTOC(reset);
+    invalidateSnapshot();
+
+    // taken before the reset, so we can't miss the re-enumeration
+    const uint32_t addCnt = mpNetMd->deviceAddCount();
+    int ret = mpSecure->finalizeTOC(reset, mTOCProgressCallback);
 
     if (reset && (ret == NETMDERR_NO_ERROR))
     {
-        int wait = resetWait * 1'000 / 10;
-        for(int i = 91; i < 100; i++)
+        constexpr int MIN_WAIT_MS = 2'000;
+        constexpr int POLL_MS     =   500;
+        const int     maxMs       = std::max(resetWait * 1'000, MIN_WAIT_MS);
+
+        ret = NETMDERR_TIMEOUT;
+
+        if (mpNetMd->mbHotPlug)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(wait));
-            mLOG(CAPTURE) << "Finalizing TOC: " << std::setw(2) << std::setfill('0') << i << "%";
+            // hotplug re-opens and syncs the device for us
+            for (int elapsed = 0; elapsed < maxMs; elapsed += POLL_MS)
+            {
+                if (mpNetMd->waitForDeviceAdded(addCnt, POLL_MS) == NETMDERR_NO_ERROR)
+                {
+                    ret = NETMDERR_NO_ERROR;
+                    break;
+                }
+                tocProgress(90 + 10 * elapsed / maxMs);
+            }
         }
-        if (!mpNetMd->mbHotPlug)
+        else
         {
-            ret = initDevice();
+            int elapsed = 0;
+
+            // initDevice() would happily re-open the old device
+            // before it drops off the bus, so wait for that first
+            while ((elapsed < maxMs) && mpNetMd->deviceOnBus())
+            {
+                tocProgress(90 + 10 * elapsed / maxMs);
+                std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+                elapsed += POLL_MS;
+            }
+
+            // never seen gone -> like before: one try after the full wait
+            do
+            {
+                if (initDevice() == NETMDERR_NO_ERROR)
+                {
+                    ret = NETMDERR_NO_ERROR;
+                    break;
+                }
+
+                tocProgress(90 + 10 * elapsed / maxMs);
+                std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+                elapsed += POLL_MS;
+            }
+            while (elapsed < maxMs);
+        }
+
+        if (ret != NETMDERR_NO_ERROR)
+        {
+            mLOG(CRITICAL) << "Device didn't come back after reset!";
         }
     }
-    mLOG(CAPTURE) << "Finalizing TOC: 100%";
+    tocProgress(100);
     return ret;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      report TOC progress (callback or log)
+//!
+//! @param[in]  percent  The progress in percent
+//--------------------------------------------------------------------------
+void CNetMdApi::tocProgress(int percent)
+{
+    if (mTOCProgressCallback)
+    {
+        mTOCProgressCallback(percent);
+    }
+    else
+    {
+        mLOG(CAPTURE) << "Finalizing TOC: " << std::setw(2) << std::setfill('0') << percent << "%";
+    }
+}
+
 //------------------------------------------------------------------------------
 //! @brief      is TOC manipulation supported
 //!
@@ -1084,6 +2129,8 @@ void CNetMdApi::hotplugEvent(bool added)
         mHotplugCallback(added);
     }
 
+    invalidateSnapshot();
+
     if (!added)
     {
         mLOG(INFO) << "Device removed";
@@ -1106,4 +2153,15 @@ void CNetMdApi::registerForHotplugEvents(EvtCallback cb)
     mHotplugCallback = cb;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      register TOC progress callback function
+//
+//! @param[in]  cb  callback function to be called with the progress of
+//!                 finalizeTOC(); if is nullptr, progress is logged
+//--------------------------------------------------------------------------
+void CNetMdApi::registerForTOCProgress(ProgressCallback cb)
+{
+    mTOCProgressCallback = cb;
+}
+
 } // ~namespace
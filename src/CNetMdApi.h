@@ -50,6 +50,9 @@ enum HomebrewFeatures : uint32_t
 /// the API class
 class CNetMdApi;
 
+/// UTOC model
+class CNetMdUTOC;
+
 /// usable as netmd_pp
 using  netmd_pp = CNetMdApi;
 
@@ -111,6 +114,48 @@ public:
     //--------------------------------------------------------------------------
     static void setLogStream(std::ostream& os);
 
+    //--------------------------------------------------------------------------
+    //! @brief      Enables / disables asynchronous logging. Log records are
+    //!             written by a background thread, so logging doesn't add
+    //!             to the device I/O timing.
+    //!
+    //! @param[in]  async        true -> log through writer thread
+    //! @param[in]  blockIfFull  if the log ring is full: true -> wait;
+    //!                          false -> drop the message
+    //--------------------------------------------------------------------------
+    static void setLogAsync(bool async, bool blockIfFull = false);
+
+    //--------------------------------------------------------------------------
+    //! @brief      Sets the device cache file. Firmware version and patch
+    //!             slot contents are remembered per device in this file, so
+    //!             that a reconnect doesn't need the full device discovery.
+    //!             Patch slots are verified with one read; the firmware
+    //!             version isn't, so remove the file after a firmware
+    //!             update.
+    //!
+    //! @param[in]  file  The cache file name (empty -> no cache)
+    //--------------------------------------------------------------------------
+    static void setDeviceCache(const std::string& file);
+
+    //--------------------------------------------------------------------------
+    //! @brief      enable / disable the USB trace. Every USB exchange is
+    //!             recorded with its timing in a ring of the given size;
+    //!             enabling drops all recorded events.
+    //!
+    //! @param[in]  events  The ring size in events (0 -> disable)
+    //--------------------------------------------------------------------------
+    void enableTrace(size_t events = 4096);
+
+    //--------------------------------------------------------------------------
+    //! @brief      export the USB trace as Chrome trace JSON (can be opened in
+    //!             chrome://tracing or the Perfetto UI)
+    //!
+    //! @param      os    The stream to write to
+    //!
+    //! @return     number of exported events
+    //--------------------------------------------------------------------------
+    size_t exportTrace(std::ostream& os);
+
     //--------------------------------------------------------------------------
     //! @brief      cache table of contents
     //!
@@ -200,6 +245,16 @@ public:
     //--------------------------------------------------------------------------
     int moveTrack(uint16_t from, uint16_t to);
 
+    //--------------------------------------------------------------------------
+    //! @brief      reorder all tracks with the fewest possible moves
+    //!
+    //! @param[in]  newOrder  old track numbers in new order
+    //!                       (newOrder[0] -> becomes track 0)
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int reorderTracks(const std::vector<uint16_t>& newOrder);
+
     //--------------------------------------------------------------------------
     //! @brief      Sets the group title.
     //!
@@ -259,6 +314,16 @@ public:
     //--------------------------------------------------------------------------
     int deleteTrack(uint16_t track);
 
+    //--------------------------------------------------------------------------
+    //! @brief      delete several tracks at once; the group header is
+    //!             updated locally and written once
+    //!
+    //! @param[in]  tracks  The track numbers
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int deleteTracks(const std::vector<uint16_t>& tracks);
+
     //--------------------------------------------------------------------------
     //! @brief      get track bitrate data
     //!
@@ -353,6 +418,68 @@ public:
     //--------------------------------------------------------------------------
     int sendAudioFile(const std::string& filename, const std::string& title, DiskFormat otf);
 
+    //--------------------------------------------------------------------------
+    //! @brief      Sends an album as one gapless recording
+    //!
+    //! Only available if @ref tocManipSupported returns true. All files are
+    //! transferred in one go as a single track, which is then split through
+    //! UTOC edit. Split points are placed on sound group borders computed
+    //! from the sample counts. Titles and recording time are written to the
+    //! UTOC and the TOC is finalized once (includes a device reset).
+    //! All files must be PCM WAVE files (44.1kHz / 16 bit) with the same
+    //! channel count.
+    //!
+    //! @param[in]  tracks  The album tracks in play order
+    //! @param[in]  otf     The disk format
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int sendAlbum(const AlbumTracks& tracks, DiskFormat otf);
+
+    //--------------------------------------------------------------------------
+    //! @brief      Sends an album described by a CUE sheet
+    //!
+    //! Same as @ref sendAlbum, but the album is one PCM WAVE file and the
+    //! track borders and titles are taken from the CUE sheet (one FILE entry,
+    //! INDEX 01 marks the track start).
+    //!
+    //! @param[in]  cueFile  The CUE sheet
+    //! @param[in]  otf      The disk format
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int sendCueAlbum(const std::string& cueFile, DiskFormat otf);
+
+    //--------------------------------------------------------------------------
+    //! @brief      split a track without audio transfer
+    //!
+    //! Only available if @ref tocManipSupported returns true. The track is
+    //! split through UTOC edit, the second part becomes the next track
+    //! (untitled) and joins the group of the split track. Finalizes the TOC
+    //! (includes a device reset).
+    //!
+    //! @param[in]  track   The track number (starting with 0)
+    //! @param[in]  groups  The split position in sound groups from track start
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int splitTrack(uint16_t track, uint32_t groups);
+
+    //--------------------------------------------------------------------------
+    //! @brief      join two tracks without audio transfer
+    //!
+    //! Only available if @ref tocManipSupported returns true. The audio of
+    //! the second track is appended to the first track through UTOC edit;
+    //! the second track with its title is removed. Both tracks must use the
+    //! same encoding. Finalizes the TOC (includes a device reset).
+    //!
+    //! @param[in]  first   The first track number (starting with 0)
+    //! @param[in]  second  The second track number (starting with 0)
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int joinTracks(uint16_t first, uint16_t second);
+
     //--------------------------------------------------------------------------
     //! @brief      Sets the track title.
     //!
@@ -363,6 +490,15 @@ public:
     //--------------------------------------------------------------------------
     int setTrackTitle(uint16_t trackNo, const std::string& title);
 
+    //--------------------------------------------------------------------------
+    //! @brief      Sets several track titles at once.
+    //!
+    //! @param[in]  titles  track number -> title
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int setTrackTitles(const std::map<uint16_t, std::string>& titles);
+
     //--------------------------------------------------------------------------
     //! @brief      get disc capacity
     //!
@@ -379,6 +515,36 @@ public:
     //--------------------------------------------------------------------------
     Groups groups();
 
+    //--------------------------------------------------------------------------
+    //! @brief      get a snapshot of all disc and track meta data
+    //!
+    //! All track data is read in one pass and cached. The cache is dropped
+    //! on write access, disc change and hotplug events. While the device is
+    //! blocked by another thread (e.g. track upload), the cached snapshot is
+    //! returned without waiting for the device.
+    //!
+    //! @param[out] snap     The buffer for the snapshot
+    //! @param[in]  refresh  force re-read if true (optional)
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int discSnapshot(DiscSnapshot& snap, bool refresh = false);
+
+    //--------------------------------------------------------------------------
+    //! @brief      list all tracks from UTOC
+    //!
+    //! Only available if @ref tocManipSupported returns true. Reads the UTOC
+    //! sectors @ref POS_ADDR, @ref HW_TITLES and @ref TSTAMPS once and decodes
+    //! title, exact length, encoding, channels and recording time of all
+    //! tracks. Track protection isn't part of the UTOC and will be set to
+    //! TrackProtection::UNKNOWN.
+    //!
+    //! @param[out] tracks  The buffer for track information
+    //!
+    //! @return     @ref NetMdErr
+    //--------------------------------------------------------------------------
+    int utocTrackList(TrackInfos& tracks);
+
     //--------------------------------------------------------------------------
     //! @brief      Reads an utoc sector.
     //!
@@ -403,9 +569,12 @@ public:
     //! @brief      finalize TOC through exploit
     //!
     //! @param[in]  reset      do reset if true (default: false)
-    //! @param[in]  resetWait  The optional reset wait time (20 seconds)
+    //! @param[in]  resetWait  The optional max. reset wait time (20 seconds)
     //!                        Only needed if reset is true
     //!
+    //! @note       With reset, don't call this with locked device mutex;
+    //!             hotplug needs it to re-open the device.
+    //!
     //! @return     NetMdErr
     //! @see        NetMdErr
     //--------------------------------------------------------------------------
@@ -438,6 +607,14 @@ public:
     //--------------------------------------------------------------------------
     void registerForHotplugEvents(EvtCallback cb);
 
+    //--------------------------------------------------------------------------
+    //! @brief      register TOC progress callback function
+    //
+    //! @param[in]  cb  callback function to be called with the progress of
+    //!                 finalizeTOC(); if is nullptr, progress is logged
+    //--------------------------------------------------------------------------
+    void registerForTOCProgress(ProgressCallback cb);
+
 protected:
     //--------------------------------------------------------------------------
     //! @brief      register device callback function
@@ -446,6 +623,94 @@ protected:
     //--------------------------------------------------------------------------           
     void hotplugEvent(bool added);
 
+    //--------------------------------------------------------------------------
+    //! @brief      report TOC progress (callback or log)
+    //!
+    //! @param[in]  percent  The progress in percent
+    //--------------------------------------------------------------------------
+    void tocProgress(int percent);
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track time without descriptor handshake
+    //!
+    //! @param[in]  trackNo    The track no
+    //! @param[out] trackTime  The track time
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int readTrackTime(int trackNo, TrackTime& trackTime);
+
+    //--------------------------------------------------------------------------
+    //! @brief      read all disc and track meta data in one pass
+    //!
+    //! @param[out] snap  The buffer for the snapshot
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int readSnapshot(DiscSnapshot& snap);
+
+    //--------------------------------------------------------------------------
+    //! @brief      send WAVE files as one track and split it in the UTOC
+    //!
+    //! @param[in]  files   The PCM WAVE files
+    //! @param[in]  titles  The track titles
+    //! @param[in]  starts  The track start positions in samples; if empty
+    //!                     every file is one track
+    //! @param[in]  otf     The disk format
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int sendAlbumWave(const std::vector<std::string>& files, const std::vector<std::string>& titles,
+                      const std::vector<uint64_t>& starts, DiskFormat otf);
+
+    //--------------------------------------------------------------------------
+    //! @brief      read UTOC sectors into UTOC model (device must be locked)
+    //!
+    //! @param[out] utoc  The UTOC model
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int loadUTOC(CNetMdUTOC& utoc);
+
+    //--------------------------------------------------------------------------
+    //! @brief      write changed UTOC sectors with locked device, then unlock
+    //!             and finalize TOC (includes device reset). The lock must
+    //!             be the only one held, since hotplug needs the device
+    //!             mutex to re-open the device after the reset.
+    //!
+    //! @param[in]  utoc  The UTOC model
+    //! @param      lck   The device lock (unlocked on return)
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int commitUTOC(CNetMdUTOC& utoc, std::unique_lock<std::recursive_mutex>& lck);
+
+    //--------------------------------------------------------------------------
+    //! @brief      drop cached disc snapshot and - unless told otherwise -
+    //!             the known UTOC sector images
+    //!
+    //! @param[in]  keepUTOCImages  true for UTOC writes, which keep the
+    //!                             sector images up to date themselves
+    //--------------------------------------------------------------------------
+    void invalidateSnapshot(bool keepUTOCImages = false);
+
+    //--------------------------------------------------------------------------
+    //! @brief      write one track title (TOC must be cached by caller)
+    //!
+    //! @param[in]  trackNo  The track no
+    //! @param[in]  title    The title
+    //! @param[in]  oldSz    size of the current title
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int writeTrackTitle(uint16_t trackNo, const std::string& title, uint8_t oldSz);
+
 private:
     /// disc header
     CMDiscHeader* mpDiscHeader;
@@ -461,6 +726,15 @@ private:
 
     /// mutex for hotplug callback
     std::mutex mMutexHotplug;
+
+    /// TOC progress callback function
+    ProgressCallback mTOCProgressCallback;
+
+    /// cached disc snapshot
+    DiscSnapshot mSnapshot;
+
+    /// mutex for disc snapshot
+    std::mutex mMtxSnapshot;
 };
 
 } // ~namespace
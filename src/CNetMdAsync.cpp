@@ -0,0 +1,153 @@
+/*
+ * CNetMdAsync.cpp
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#include "CNetMdAsync.h"
+#include "log.h"
+#include <exception>
+
+namespace netmd {
+
+//--------------------------------------------------------------------------
+//! @brief      Constructs a new instance and starts the worker thread.
+//!
+//! @param[in]  api   The API instance of the device (must outlive us)
+//--------------------------------------------------------------------------
+CNetMdAsync::CNetMdAsync(CNetMdApi& api)
+    : mApi(api), mStop(false)
+{
+    mWorker = std::thread(&CNetMdAsync::worker, this);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      Destroys the object. Waits for the running job, pending
+//!             jobs are dropped (futures report broken promise).
+//--------------------------------------------------------------------------
+CNetMdAsync::~CNetMdAsync()
+{
+    {
+        std::unique_lock<std::mutex> lck(mMtxJobs);
+        mStop = true;
+    }
+    mCondJobs.notify_all();
+
+    if (mWorker.joinable())
+    {
+        mWorker.join();
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      number of queued jobs (running job not included)
+//!
+//! @return     pending jobs
+//--------------------------------------------------------------------------
+size_t CNetMdAsync::pending() const
+{
+    std::unique_lock<std::mutex> lck(mMtxJobs);
+    size_t cnt = 0;
+    for (const auto& q : mJobs)
+    {
+        cnt += q.size();
+    }
+    return cnt;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      add a job to the queue
+//!
+//! @param[in]  job   The job
+//! @param[in]  prio  The priority
+//--------------------------------------------------------------------------
+void CNetMdAsync::enqueue(Job job, Prio prio)
+{
+    if (prio >= Prio::MAX_PRIO)
+    {
+        prio = Prio::NORMAL;
+    }
+
+    {
+        std::unique_lock<std::mutex> lck(mMtxJobs);
+        mJobs[static_cast<size_t>(prio)].push_back(std::move(job));
+    }
+    mCondJobs.notify_one();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      worker thread function
+//--------------------------------------------------------------------------
+void CNetMdAsync::worker()
+{
+    for (;;)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lck(mMtxJobs);
+            mCondJobs.wait(lck, [this]()
+            {
+                if (mStop) return true;
+                for (const auto& q : mJobs)
+                {
+                    if (!q.empty()) return true;
+                }
+                return false;
+            });
+
+            if (mStop)
+            {
+                break;
+            }
+
+            // highest priority first, FIFO within one priority
+            for (auto& q : mJobs)
+            {
+                if (!q.empty())
+                {
+                    job = std::move(q.front());
+                    q.pop_front();
+                    break;
+                }
+            }
+        }
+
+        try
+        {
+            job(mApi);
+        }
+        catch (const std::exception& e)
+        {
+            mLOG(CRITICAL) << "Async job failed: " << e.what();
+        }
+        catch (...)
+        {
+            mLOG(CRITICAL) << "Async job failed!";
+        }
+    }
+}
+
+} // ~namespace
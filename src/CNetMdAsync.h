@@ -0,0 +1,165 @@
+/*
+ * CNetMdAsync.h
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#pragma once
+#include "CNetMdApi.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace netmd {
+
+//------------------------------------------------------------------------------
+//! @brief      Asynchronous facade for CNetMdApi. All jobs for one device
+//!             run in order on a single worker thread. Jobs with higher
+//!             priority are served before queued jobs of lower priority.
+//!             A running job is never interrupted: an upload keeps the
+//!             device for the whole transfer, so queries queued meanwhile
+//!             run after it. Use CNetMdApi::discSnapshot() from another
+//!             thread to get cached meta data during an upload.
+//------------------------------------------------------------------------------
+class CNetMdAsync
+{
+public:
+    /// job priority
+    enum class Prio : uint8_t
+    {
+        HIGH,       //!< short meta data queries
+        NORMAL,     //!< default
+        LOW,        //!< long running jobs (uploads, TOC edits)
+        MAX_PRIO    //!< number of priorities
+    };
+
+    /// a job running on the worker thread
+    using Job = std::function<void(CNetMdApi&)>;
+
+    //--------------------------------------------------------------------------
+    //! @brief      Constructs a new instance and starts the worker thread.
+    //!
+    //! @param[in]  api   The API instance of the device (must outlive us)
+    //--------------------------------------------------------------------------
+    CNetMdAsync(CNetMdApi& api);
+
+    //--------------------------------------------------------------------------
+    //! @brief      Destroys the object. Waits for the running job, pending
+    //!             jobs are dropped (futures report broken promise).
+    //--------------------------------------------------------------------------
+    ~CNetMdAsync();
+
+    //--------------------------------------------------------------------------
+    //! @brief      queue a job, get the result through a future
+    //!
+    //! @param[in]  f     callable taking CNetMdApi&
+    //! @param[in]  prio  The priority
+    //!
+    //! @return     future for the result of f
+    //--------------------------------------------------------------------------
+    template<typename F>
+    auto submit(F&& f, Prio prio = Prio::NORMAL) -> std::future<std::invoke_result_t<F, CNetMdApi&>>
+    {
+        using Ret  = std::invoke_result_t<F, CNetMdApi&>;
+        auto  task = std::make_shared<std::packaged_task<Ret(CNetMdApi&)>>(std::forward<F>(f));
+        std::future<Ret> fut = task->get_future();
+        enqueue([task](CNetMdApi& api) { (*task)(api); }, prio);
+        return fut;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      queue a job, get the result through a callback; the
+    //!             callback is called on the worker thread
+    //!
+    //! @param[in]  f     callable taking CNetMdApi&
+    //! @param[in]  cb    completion callback taking the result of f
+    //!                   (or nothing if f returns void)
+    //! @param[in]  prio  The priority
+    //--------------------------------------------------------------------------
+    template<typename F, typename CB>
+    void post(F&& f, CB&& cb, Prio prio = Prio::NORMAL)
+    {
+        enqueue([f = std::forward<F>(f), cb = std::forward<CB>(cb)](CNetMdApi& api) mutable
+        {
+            if constexpr (std::is_void_v<std::invoke_result_t<F, CNetMdApi&>>)
+            {
+                f(api);
+                cb();
+            }
+            else
+            {
+                cb(f(api));
+            }
+        }, prio);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      number of queued jobs (running job not included)
+    //!
+    //! @return     pending jobs
+    //--------------------------------------------------------------------------
+    size_t pending() const;
+
+protected:
+    //--------------------------------------------------------------------------
+    //! @brief      add a job to the queue
+    //!
+    //! @param[in]  job   The job
+    //! @param[in]  prio  The priority
+    //--------------------------------------------------------------------------
+    void enqueue(Job job, Prio prio);
+
+    //--------------------------------------------------------------------------
+    //! @brief      worker thread function
+    //--------------------------------------------------------------------------
+    void worker();
+
+private:
+    /// the API instance
+    CNetMdApi& mApi;
+
+    /// job queues, one per priority
+    std::deque<Job> mJobs[static_cast<size_t>(Prio::MAX_PRIO)];
+
+    /// protects job queues
+    mutable std::mutex mMtxJobs;
+
+    /// signals new jobs / stop
+    std::condition_variable mCondJobs;
+
+    /// stop marker
+    bool mStop;
+
+    /// the worker thread
+    std::thread mWorker;
+};
+
+} // ~namespace
@@ -28,6 +28,7 @@
  */
 
 #include "CNetMdDev.hpp"
+#include "CNetMdDevCache.h"
 #include "log.h"
 #include "netmd_defines.h"
 #include "netmd_utils.h"
@@ -116,7 +117,7 @@ const CNetMdDev::DscrtData CNetMdDev::smDescrData = {
     {CNetMdDev::Descriptor::operatingStatusBlock  , {0x80, 0x00}      },
 };
 
-const CNetMdDev::NetMDDevice CNetMdDev::UNINIT_DEV = {SKnownDevice{0, 0, nullptr, false, false, false}, "", nullptr, nullptr, SDI_UNKNOWN, false};
+const CNetMdDev::NetMDDevice CNetMdDev::UNINIT_DEV = {SKnownDevice{0, 0, nullptr, false, false, false}, "", nullptr, nullptr, SDI_UNKNOWN, false, ""};
 
 //--------------------------------------------------------------------------
 //! @brief      print helper for SonyDevInfo
@@ -274,6 +275,7 @@ int CNetMdDev::initDevice()
                 // in case hotplug wasn't enabled, we do a complete device recognition
                 libusb_close(mDevice.mDevHdl);
                 mDevice = UNINIT_DEV;
+                mDscrtStates.clear();
                 if (mDevApiCallback)
                 {
                     mDevApiCallback(false);
@@ -406,6 +408,7 @@ int CNetMdDev::openDevice(libusb_device* dev, libusb_device_descriptor* desc)
                 libusb_close(mDevice.mDevHdl);
             }
             mDevice = UNINIT_DEV;
+            mDscrtStates.clear();
             ret = NETMDERR_USB;
             mLOG(CRITICAL) << "Can't init usb device!";
         }
@@ -438,6 +441,7 @@ int CNetMdDev::deviceRemoved(libusb_context*, libusb_device *device, libusb_hotp
             mLOG(INFO) << "Device " << pDev->mDevice.mKnownDev.mModel  << " @ " << device << " removed.";
             libusb_close(pDev->mDevice.mDevHdl);
             pDev->mDevice = UNINIT_DEV;
+            pDev->mDscrtStates.clear();
             if (pDev->mDevApiCallback)
             {
                 pDev->mDevApiCallback(false);
@@ -470,6 +474,13 @@ int CNetMdDev::deviceAdded(libusb_context*, libusb_device *device, libusb_hotplu
 
             if (pDev->openDevice(device, &desc) == NETMDERR_NO_ERROR) 
             {
+                // device is open and synced
+                {
+                    std::unique_lock<std::mutex> addLck(pDev->mMtxDevAdded);
+                    pDev->mDevAddCnt++;
+                }
+                pDev->mCondDevAdded.notify_all();
+
                 if (pDev->mDevApiCallback)
                 {
                     pDev->mDevApiCallback(true);
@@ -583,6 +594,32 @@ int CNetMdDev::getStrings(const libusb_device_descriptor& descr)
         }
     }
 
+    // device cache key: serial number if there, fingerprint otherwise
+    if ((descr.iSerialNumber != 0)
+        && ((sz = libusb_get_string_descriptor_ascii(mDevice.mDevHdl, descr.iSerialNumber, buff, 255)) > 0))
+    {
+        mDevice.mCacheKey = "sn:" + std::string(reinterpret_cast<char*>(buff), sz);
+    }
+    else
+    {
+        std::ostringstream key;
+        libusb_device* dev = libusb_get_device(mDevice.mDevHdl);
+        uint8_t ports[8];
+
+        key << "usb:" << std::hex << std::setfill('0') << std::setw(4) << descr.idVendor << ":"
+            << std::setw(4) << descr.idProduct << ":" << std::setw(4) << descr.bcdDevice << std::dec
+            << "@" << static_cast<int>(libusb_get_bus_number(dev));
+
+        for (int i = 0; i < libusb_get_port_numbers(dev, ports, sizeof(ports)); i++)
+        {
+            key << (i ? "." : "-") << static_cast<int>(ports[i]);
+        }
+
+        mDevice.mCacheKey = key.str();
+    }
+
+    mLOG(DEBUG) << "Device cache key: " << mDevice.mCacheKey;
+
     return ret;
 }
 
@@ -607,11 +644,12 @@ std::string CNetMdDev::getDeviceName()
 int CNetMdDev::responseLength(uint8_t& req)
 {
     std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+    CNetMdTrace::Scope trc(mTrace, CNetMdTrace::TRC_RESPONSE_LENGTH);
 
     if (mDevice.mDevHdl == nullptr)
     {
         mLOG(CRITICAL) << "No NetMD device available!";
-        return NETMDERR_NOTREADY;
+        return trc.done(NETMDERR_NOTREADY);
     }
 
     uint8_t pollbuf[] = {0, 0, 0, 0};
@@ -623,16 +661,16 @@ int CNetMdDev::responseLength(uint8_t& req)
         if (pollbuf[0] != 0)
         {
             req = pollbuf[1];
-            return (static_cast<int>(pollbuf[3]) << 8) | static_cast<int>(pollbuf[2]);
+            return trc.done((static_cast<int>(pollbuf[3]) << 8) | static_cast<int>(pollbuf[2]));
         }
     }
     else if (ret < 0)
     {
         mLOG(DEBUG) << "Error while polling for response: " << libusb_strerror(static_cast<libusb_error>(ret));
-        return -1;
+        return trc.done(-1);
     }
 
-    return 0;
+    return trc.done(0);
 }
 
 //--------------------------------------------------------------------------
@@ -678,13 +716,14 @@ int CNetMdDev::sendCmd(unsigned char* cmd, size_t cmdLen, bool factory)
     // send data
     mLOG(DEBUG) << (factory ? "factory " : "") << "command:" << LOG::hexFormat(DEBUG, cmd, cmdLen);
 
-    // read any data still in response queue
-    // of the NetMD device
-    cleanupRespQueue();
-
     int ret;
 
     std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+    CNetMdTrace::Scope trc(mTrace, CNetMdTrace::TRC_SEND_CMD, cmd, cmdLen);
+
+    // read any data still in response queue
+    // of the NetMD device
+    cleanupRespQueue();
 
     if ((ret = libusb_control_transfer(mDevice.mDevHdl,
                                        LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
@@ -692,10 +731,10 @@ int CNetMdDev::sendCmd(unsigned char* cmd, size_t cmdLen, bool factory)
                                        NETMD_SEND_TIMEOUT)) < 0)
     {
         mLOG(CRITICAL) << "libusb_control_transfer failed! " << libusb_strerror(static_cast<libusb_error>(ret));
-        return NETMDERR_USB;
+        return trc.done(NETMDERR_USB);
     }
 
-    return NETMDERR_NO_ERROR;
+    return trc.done(NETMDERR_NO_ERROR);
 }
 
 //--------------------------------------------------------------------------
@@ -715,6 +754,7 @@ int CNetMdDev::getResponse(NetMDResp& response, int overrideRespLength)
     int tmOut = NETMD_RECV_TIMEOUT;
 
     std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+    CNetMdTrace::Scope trc(mTrace, CNetMdTrace::TRC_GET_RESPONSE);
 
     if (overrideRespLength != -1)
     {
@@ -730,14 +770,14 @@ int CNetMdDev::getResponse(NetMDResp& response, int overrideRespLength)
             if (ret < 0)
             {
                 mLOG(DEBUG) << "try again ...";
-                return NETMDERR_AGAIN;
+                return trc.done(NETMDERR_AGAIN);
             }
 
             // we shouldn't try forever ...
             if (i == NETMD_RECV_TRIES)
             {
                 mLOG(CRITICAL) << "Timeout while waiting for response length!";
-                return NETMDERR_TIMEOUT;
+                return trc.done(NETMDERR_TIMEOUT);
             }
 
             // Double wait time every 10 attempts up to 1 sec
@@ -749,7 +789,9 @@ int CNetMdDev::getResponse(NetMDResp& response, int overrideRespLength)
                 mLOG(DEBUG) << "still polling ... (" << i << " / " << NETMD_RECV_TRIES << " / " << sleep / 1000 << " ms)";
             }
 
+            auto start = std::chrono::steady_clock::now();
             std::this_thread::sleep_for(std::chrono::microseconds(sleep));
+            mTrace.slept(sleep, std::chrono::steady_clock::now() - start);
             i++;
         }
     }
@@ -763,7 +805,7 @@ int CNetMdDev::getResponse(NetMDResp& response, int overrideRespLength)
                                        tmOut)) < 0)
     {
         mLOG(CRITICAL) << "libusb_control_transfer failed! " << libusb_strerror(static_cast<libusb_error>(ret));
-        return NETMDERR_USB;
+        return trc.done(NETMDERR_USB);
     }
 
     mLOG(DEBUG)  << "Response: 0x" << std::hex << std::setw(2) << std::setfill('0')
@@ -771,7 +813,7 @@ int CNetMdDev::getResponse(NetMDResp& response, int overrideRespLength)
                  << std::dec << LOG::hexFormat(DEBUG, response.get(), ret);
 
     // return length
-    return ret;
+    return trc.done(ret, response[0]);
 }
 
 //--------------------------------------------------------------------------
@@ -791,11 +833,12 @@ int CNetMdDev::exchange(unsigned char* cmd, size_t cmdLen, NetMDResp* response,
 {
     mFLOW(DEBUG);
     std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+    CNetMdTrace::Scope trc(mTrace, CNetMdTrace::TRC_EXCHANGE, cmd, cmdLen);
 
     if (mDevice.mDevHdl == nullptr)
     {
         mLOG(CRITICAL) << "No NetMD device available!";
-        return NETMDERR_NOTREADY;
+        return trc.done(NETMDERR_NOTREADY);
     }
 
     int ret = 0;
@@ -847,7 +890,13 @@ int CNetMdDev::exchange(unsigned char* cmd, size_t cmdLen, NetMDResp* response,
     }
     while(redo > 0);
 
-    return ret;
+    if (ret < 0)
+    {
+        // device state is unclear after an error
+        mDscrtStates.clear();
+    }
+
+    return trc.done(ret, (*pResp == nullptr) ? 0 : (*pResp)[0]);
 }
 
 //--------------------------------------------------------------------------
@@ -862,11 +911,12 @@ int CNetMdDev::exchange(unsigned char* cmd, size_t cmdLen, NetMDResp* response,
 int CNetMdDev::bulkTransfer(unsigned char* cmd, size_t cmdLen, int timeOut)
 {
     std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+    CNetMdTrace::Scope trc(mTrace, CNetMdTrace::TRC_BULK_TRANSFER, cmd, cmdLen);
 
     if (mDevice.mDevHdl == nullptr)
     {
         mLOG(CRITICAL) << "No NetMD device available!";
-        return NETMDERR_NOTREADY;
+        return trc.done(NETMDERR_NOTREADY);
     }
 
     int bytesDone = 0, sent, err = 0;
@@ -887,13 +937,13 @@ int CNetMdDev::bulkTransfer(unsigned char* cmd, size_t cmdLen, int timeOut)
             {
                 mLOG(CRITICAL) << "USB transfer error while transffering "
                                << cmdLen << " bytes: " << libusb_strerror(static_cast<libusb_error>(err));
-                return NETMDERR_USB;
+                return trc.done(NETMDERR_USB);
             }
         }
     }
     while(bytesDone < static_cast<int>(cmdLen));
 
-    return bytesDone;
+    return trc.done(bytesDone);
 }
 
 //--------------------------------------------------------------------------
@@ -1014,14 +1064,33 @@ int CNetMdDev::changeDscrtState(Descriptor d, DscrtAction a)
 
     if (cit != smDescrData.cend())
     {
+        std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+        DscrtStates::const_iterator sit = mDscrtStates.find(d);
+
+        if (sit != mDscrtStates.cend())
+        {
+            if (sit->second == a)
+            {
+                // already there
+                return NETMDERR_NO_ERROR;
+            }
+            else if ((sit->second != DscrtAction::close) && (a != DscrtAction::close))
+            {
+                // switch between read and write -> close first
+                if ((ret = changeDscrtState(d, DscrtAction::close)) != NETMDERR_NO_ERROR)
+                {
+                    return ret;
+                }
+            }
+        }
+
         NetMDResp query;
         if (((ret = formatQuery("00 1808 %* %b 00", {{cit->second}, {mBYTE(a)}}, query)) > 0)
             && (query != nullptr))
         {
-            std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
-
             if ((ret = exchange(query.get(), ret)) > 0)
             {
+                mDscrtStates[d] = a;
                 ret = NETMDERR_NO_ERROR;
             }
         }
@@ -1029,6 +1098,15 @@ int CNetMdDev::changeDscrtState(Descriptor d, DscrtAction a)
     return ret;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      forget all known descriptor states
+//--------------------------------------------------------------------------
+void CNetMdDev::resetDscrtStates()
+{
+    std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+    mDscrtStates.clear();
+}
+
 //--------------------------------------------------------------------------
 //! @brief      check for this device might be patchable
 //!
@@ -1095,6 +1173,43 @@ int CNetMdDev::writeMetadataPeripheral(uint16_t sector, uint16_t offset, const N
     return NETMDERR_PARAM;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      read operating status from operating status block
+//!
+//! @return     < 0 -> NetMdErr; else operating status (see NETMD_OPSTAT_*)
+//--------------------------------------------------------------------------
+int CNetMdDev::operatingStatus()
+{
+    mFLOW(DEBUG);
+    std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+
+    NetMDResp   query, response;
+    NetMDParams params;
+    int ret = NETMDERR_CMD_FAILED;
+
+    if ((ret = formatQuery("00 1809 8001 0330 8802 0030 8805 0030 8806 00 ff00 00000000", {}, query)) <= 0)
+    {
+        return NETMDERR_PARAM;
+    }
+
+    static_cast<void>(changeDscrtState(Descriptor::operatingStatusBlock, DscrtAction::openread));
+
+    int sz = exchange(query.get(), ret, &response);
+    ret    = (sz < 0) ? sz : NETMDERR_CMD_FAILED;
+
+    if ((sz > 0) && (response != nullptr)
+        && (scanQuery(response.get(), sz, "%? 1809 8001 0330 8802 0030 8805 0030 8806 00 1000 00%?0000 0006 8806 0002 %>w",
+                      params) == NETMDERR_NO_ERROR)
+        && (params.size() == 1) && (params.at(0).index() == UINT16_T))
+    {
+        ret = simple_get<uint16_t>(params.at(0));
+    }
+
+    static_cast<void>(changeDscrtState(Descriptor::operatingStatusBlock, DscrtAction::close));
+
+    return ret;
+}
+
 //------------------------------------------------------------------------------
 //! @brief      open for read, read, close
 //!
@@ -1108,11 +1223,8 @@ int CNetMdDev::writeMetadataPeripheral(uint16_t sector, uint16_t offset, const N
 int CNetMdDev::cleanRead(uint32_t addr, uint8_t sz, NetMDByteVector& data)
 {
     mFLOW(DEBUG);
-    int ret;
-    static_cast<void>(changeMemState(addr, sz, MemAcc::NETMD_MEM_READ));
-    ret = patchRead(addr, sz, data);
-    static_cast<void>(changeMemState(addr, sz, MemAcc::NETMD_MEM_CLOSE));
-    return ret;
+    MemSession ms(*this, addr, sz, MemAcc::NETMD_MEM_READ);
+    return ms.read(addr, sz, data);
 }
 
 //------------------------------------------------------------------------------
@@ -1127,11 +1239,59 @@ int CNetMdDev::cleanRead(uint32_t addr, uint8_t sz, NetMDByteVector& data)
 int CNetMdDev::cleanWrite(uint32_t addr, const NetMDByteVector& data)
 {
     mFLOW(DEBUG);
-    int ret;
-    static_cast<void>(changeMemState(addr, data.size(), MemAcc::NETMD_MEM_WRITE));
-    ret = patchWrite(addr, data);
-    static_cast<void>(changeMemState(addr, data.size(), MemAcc::NETMD_MEM_CLOSE));
-    return ret;
+    MemSession ms(*this, addr, data.size(), MemAcc::NETMD_MEM_WRITE);
+    return ms.write(addr, data);
+}
+
+//------------------------------------------------------------------------------
+//! @brief      open memory region
+//!
+//! @param[in]  dev   The NetMD device
+//! @param[in]  addr  The start address
+//! @param[in]  size  The region size
+//! @param[in]  acc   The memory access
+//------------------------------------------------------------------------------
+CNetMdDev::MemSession::MemSession(CNetMdDev& dev, uint32_t addr, uint8_t size, MemAcc acc)
+    : mDev(dev), mLock(dev.mMtxDevAcc), mAddr(addr), mSize(size)
+{
+    static_cast<void>(mDev.changeMemState(mAddr, mSize, acc));
+}
+
+//------------------------------------------------------------------------------
+//! @brief      close memory region
+//------------------------------------------------------------------------------
+CNetMdDev::MemSession::~MemSession()
+{
+    static_cast<void>(mDev.changeMemState(mAddr, mSize, MemAcc::NETMD_MEM_CLOSE));
+}
+
+//------------------------------------------------------------------------------
+//! @brief      read from opened memory region
+//!
+//! @param[in]  addr  address
+//! @param[in]  sz    size of data to read
+//! @param[out] data  read data
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//------------------------------------------------------------------------------
+int CNetMdDev::MemSession::read(uint32_t addr, uint8_t sz, NetMDByteVector& data)
+{
+    return mDev.patchRead(addr, sz, data);
+}
+
+//------------------------------------------------------------------------------
+//! @brief      write to opened memory region
+//!
+//! @param[in]  addr  address
+//! @param[in]  data  data to write
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//------------------------------------------------------------------------------
+int CNetMdDev::MemSession::write(uint32_t addr, const NetMDByteVector& data)
+{
+    return mDev.patchWrite(addr, data);
 }
 
 //------------------------------------------------------------------------------
@@ -1266,7 +1426,7 @@ CNetMdDev::SonyDevInfo CNetMdDev::sonyDevCode()
         {
             mDevice.mDevInfo = SDI_NO_SUPPORT;
         }
-        else
+        else if (!devInfoFromCache())
         {
             mFLOW(INFO);
             uint8_t query[] = {0x00, 0x18, 0x12, 0xff};
@@ -1379,12 +1539,71 @@ CNetMdDev::SonyDevInfo CNetMdDev::sonyDevCode()
                     }
                 }
             }
+
+            if (mDevice.mDevInfo != SDI_UNKNOWN)
+            {
+                cacheDevInfo();
+            }
         }
     }
 
     return mDevice.mDevInfo;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      take device info from device cache; not verified
+//!             against the device (see CNetMdDevCache.h)
+//!
+//! @return     true if device info was found in cache
+//--------------------------------------------------------------------------
+bool CNetMdDev::devInfoFromCache()
+{
+    CNetMdDevCache::Entry entry;
+
+    if (CNetMdDevCache::lookup(mDevice.mCacheKey, entry) != NETMDERR_NO_ERROR)
+    {
+        return false;
+    }
+
+    SonyDevInfo devInfo = static_cast<SonyDevInfo>(entry.mDevInfo);
+
+    // product string must match, device info must be a real firmware version
+    if ((entry.mName != mDevice.mName) || (devInfo < SDI_R_START) || (devInfo > SDI_S_END))
+    {
+        mLOG(DEBUG) << "Device cache entry for " << mDevice.mCacheKey << " doesn't match!";
+        static_cast<void>(CNetMdDevCache::drop(mDevice.mCacheKey));
+        return false;
+    }
+
+    mLOG(INFO) << "Device info from cache: " << devInfo;
+    mDevice.mDevInfo = devInfo;
+    return true;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write device info and product name to device cache
+//--------------------------------------------------------------------------
+void CNetMdDev::cacheDevInfo()
+{
+    if (!CNetMdDevCache::enabled())
+    {
+        return;
+    }
+
+    CNetMdDevCache::Entry entry;
+
+    // patch slots are only valid for the same device info
+    if ((CNetMdDevCache::lookup(mDevice.mCacheKey, entry) != NETMDERR_NO_ERROR)
+        || (entry.mDevInfo != mDevice.mDevInfo) || (entry.mName != mDevice.mName))
+    {
+        entry.mSlots.clear();
+    }
+
+    entry.mDevInfo = mDevice.mDevInfo;
+    entry.mName    = mDevice.mName;
+    static_cast<void>(CNetMdDevCache::store(mDevice.mCacheKey, entry));
+}
+
 //--------------------------------------------------------------------------
 //! @brief      Enables the factory mode.
 //
@@ -1444,6 +1663,75 @@ void CNetMdDev::registerDeviceCallback(EvtCallback cb)
     mDevApiCallback = cb;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      get device add counter (take it before a device reset)
+//
+//! @return     number of devices opened through hotplug
+//--------------------------------------------------------------------------
+uint32_t CNetMdDev::deviceAddCount()
+{
+    std::unique_lock<std::mutex> lock(mMtxDevAdded);
+    return mDevAddCnt;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      wait until hotplug re-opened a device;
+//!             don't call with locked device mutex! The hotplug
+//!             callback needs it to open the device.
+//
+//! @param[in]  since      device add counter taken before
+//! @param[in]  timeoutMs  The timeout in ms
+//
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdDev::waitForDeviceAdded(uint32_t since, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mMtxDevAdded);
+
+    bool added = mCondDevAdded.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]()
+    {
+        return mDevAddCnt != since;
+    });
+
+    return added ? NETMDERR_NO_ERROR : NETMDERR_TIMEOUT;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      check if the opened device is still on the bus
+//!             (e.g. to see it dropping off after a reset)
+//
+//! @return     true if so; false if gone or not opened
+//--------------------------------------------------------------------------
+bool CNetMdDev::deviceOnBus()
+{
+    std::unique_lock<std::recursive_mutex> lock(mMtxDevAcc);
+
+    if (mDevice.mDevHdl == nullptr)
+    {
+        return false;
+    }
+
+    // our handle keeps a reference, so the pointer can't be re-used
+    libusb_device*  me   = libusb_get_device(mDevice.mDevHdl);
+    libusb_device** devs = nullptr;
+    bool            ret  = false;
+
+    ssize_t cnt = libusb_get_device_list(NULL, &devs);
+
+    for (ssize_t i = 0; (i < cnt) && !ret; i++)
+    {
+        ret = (devs[i] == me);
+    }
+
+    if (devs != nullptr)
+    {
+        libusb_free_device_list(devs, 1);
+    }
+
+    return ret;
+}
+
 //--------------------------------------------------------------------------
 //! @brief      check if hotplug is supported
 //
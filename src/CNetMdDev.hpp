@@ -33,12 +33,14 @@
 #include <cstdint>
 #include <string>
 #include <mutex>
+#include <condition_variable>
 #include <functional>
 #include <thread>
 #include <atomic>
 
 #include "netmd_defines.h"
 #include "log.h"
+#include "CNetMdTrace.h"
 
 namespace netmd
 {
@@ -104,6 +106,7 @@ class CNetMdDev
         netmd_dev* mDevPtr;             ///< device pointer
         SonyDevInfo mDevInfo;           ///< device info
         bool mFactoryMode;              ///< factory mode
+        std::string mCacheKey;          ///< device cache key
     };
 
     /// an uninitialzed device
@@ -127,6 +130,9 @@ class CNetMdDev
     static constexpr unsigned int NETMD_RECV_TRIES   =  100;
     static constexpr unsigned int NETMD_SYNC_TRIES   =    5;
     
+    /// operating status: device is idle and ready
+    static constexpr uint16_t NETMD_OPSTAT_READY = 0xc5ff;
+
     /// reply retry interval
     static constexpr unsigned int NETMD_REPLY_SZ_INTERVAL_USEC     =    10'000;
     static constexpr unsigned int NETMD_MAX_REPLY_SZ_INTERVAL_USEC = 1'000'000;
@@ -140,6 +146,62 @@ class CNetMdDev
         NETMD_MEM_READ_WRITE = 0x3,
     };
 
+    //--------------------------------------------------------------------------
+    //! @brief      memory access session: opens a memory region once, allows
+    //!             any number of reads / writes and closes it on destruction.
+    //!             Device access is locked for the whole session.
+    //--------------------------------------------------------------------------
+    class MemSession
+    {
+    public:
+        //----------------------------------------------------------------------
+        //! @brief      open memory region
+        //!
+        //! @param[in]  dev   The NetMD device
+        //! @param[in]  addr  The start address
+        //! @param[in]  size  The region size
+        //! @param[in]  acc   The memory access
+        //----------------------------------------------------------------------
+        MemSession(CNetMdDev& dev, uint32_t addr, uint8_t size, MemAcc acc);
+
+        //----------------------------------------------------------------------
+        //! @brief      close memory region
+        //----------------------------------------------------------------------
+        ~MemSession();
+
+        MemSession(const MemSession&) = delete;
+        MemSession& operator=(const MemSession&) = delete;
+
+        //----------------------------------------------------------------------
+        //! @brief      read from opened memory region
+        //!
+        //! @param[in]  addr  address
+        //! @param[in]  sz    size of data to read
+        //! @param[out] data  read data
+        //!
+        //! @return     NetMdErr
+        //! @see        NetMdErr
+        //----------------------------------------------------------------------
+        int read(uint32_t addr, uint8_t sz, NetMDByteVector& data);
+
+        //----------------------------------------------------------------------
+        //! @brief      write to opened memory region
+        //!
+        //! @param[in]  addr  address
+        //! @param[in]  data  data to write
+        //!
+        //! @return     NetMdErr
+        //! @see        NetMdErr
+        //----------------------------------------------------------------------
+        int write(uint32_t addr, const NetMDByteVector& data);
+
+    private:
+        CNetMdDev& mDev;
+        std::unique_lock<std::recursive_mutex> mLock;
+        uint32_t mAddr;
+        uint8_t mSize;
+    };
+
     //--------------------------------------------------------------------------
     //! @brief      print helper for SonyDevInfo
     //!
@@ -212,6 +274,9 @@ class CNetMdDev
     /// a type for storing descriptor data
     using DscrtData = std::map<Descriptor, NetMDByteVector>;
 
+    /// a type for tracking descriptor states
+    using DscrtStates = std::map<Descriptor, DscrtAction>;
+
     //--------------------------------------------------------------------------
     //! @brief      Constructs a new instance.
     //--------------------------------------------------------------------------
@@ -368,6 +433,13 @@ class CNetMdDev
     //--------------------------------------------------------------------------
     int waitForSync();
 
+    //--------------------------------------------------------------------------
+    //! @brief      read operating status from operating status block
+    //!
+    //! @return     < 0 -> NetMdErr; else operating status (see NETMD_OPSTAT_*)
+    //--------------------------------------------------------------------------
+    int operatingStatus();
+
     //--------------------------------------------------------------------------
     //! @brief      aquire device (needed for Sharp)
     //!
@@ -383,7 +455,8 @@ class CNetMdDev
     int releaseDev();
 
     //--------------------------------------------------------------------------
-    //! @brief      change descriptor state
+    //! @brief      change descriptor state; the command is only sent if the
+    //!             descriptor isn't known to be in the wanted state already
     //!
     //! @param[in]  d     descriptor
     //! @param[in]  a     action
@@ -392,6 +465,11 @@ class CNetMdDev
     //--------------------------------------------------------------------------
     int changeDscrtState(Descriptor d, DscrtAction a);
 
+    //--------------------------------------------------------------------------
+    //! @brief      forget all known descriptor states
+    //--------------------------------------------------------------------------
+    void resetDscrtStates();
+
     //--------------------------------------------------------------------------
     //! @brief      Gets the strings from the NetMD device
     //!
@@ -497,6 +575,19 @@ class CNetMdDev
     //--------------------------------------------------------------------------
     SonyDevInfo sonyDevCode();
 
+    //--------------------------------------------------------------------------
+    //! @brief      take device info from device cache; not verified
+    //!             against the device (see CNetMdDevCache.h)
+    //!
+    //! @return     true if device info was found in cache
+    //--------------------------------------------------------------------------
+    bool devInfoFromCache();
+
+    //--------------------------------------------------------------------------
+    //! @brief      write device info and product name to device cache
+    //--------------------------------------------------------------------------
+    void cacheDevInfo();
+
     //--------------------------------------------------------------------------
     //! @brief      Enables the factory mode.
     //
@@ -515,6 +606,34 @@ class CNetMdDev
     //--------------------------------------------------------------------------
     void registerDeviceCallback(EvtCallback cb);
 
+    //--------------------------------------------------------------------------
+    //! @brief      get device add counter (take it before a device reset)
+    //
+    //! @return     number of devices opened through hotplug
+    //--------------------------------------------------------------------------
+    uint32_t deviceAddCount();
+
+    //--------------------------------------------------------------------------
+    //! @brief      wait until hotplug re-opened a device;
+    //!             don't call with locked device mutex! The hotplug
+    //!             callback needs it to open the device.
+    //
+    //! @param[in]  since      device add counter taken before
+    //! @param[in]  timeoutMs  The timeout in ms
+    //
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int waitForDeviceAdded(uint32_t since, int timeoutMs);
+
+    //--------------------------------------------------------------------------
+    //! @brief      check if the opened device is still on the bus
+    //!             (e.g. to see it dropping off after a reset)
+    //
+    //! @return     true if so; false if gone or not opened
+    //--------------------------------------------------------------------------
+    bool deviceOnBus();
+
     //--------------------------------------------------------------------------
     //! @brief      check if hotplug is supported
     //
@@ -531,6 +650,12 @@ class CNetMdDev
     /// descriptor data
     static const DscrtData smDescrData;
 
+    /// known descriptor states (not in map -> unknown)
+    DscrtStates mDscrtStates;
+
+    /// USB trace (used with locked device mutex)
+    CNetMdTrace mTrace;
+
     /// callback handle for hotplug add function
     libusb_hotplug_callback_handle mhdHPAdd;
     
@@ -543,6 +668,15 @@ class CNetMdDev
     /// hotplug callback function
     EvtCallback mDevApiCallback;
 
+    /// protects device add counter (independent from device mutex)
+    std::mutex mMtxDevAdded;
+
+    /// signaled when hotplug opened a device
+    std::condition_variable mCondDevAdded;
+
+    /// number of devices opened through hotplug
+    uint32_t mDevAddCnt = 0;
+
     /// poll thread
     std::thread mPollThread; 
 
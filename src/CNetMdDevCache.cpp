@@ -0,0 +1,276 @@
+/*
+ * CNetMdDevCache.cpp
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "CNetMdDevCache.h"
+#include "log.h"
+
+namespace netmd {
+
+/// cache file name
+std::string CNetMdDevCache::smFile;
+
+/// protects cache file
+std::mutex CNetMdDevCache::smMtx;
+
+//--------------------------------------------------------------------------
+//! @brief      set cache file; an empty name disables the cache
+//!
+//! @param[in]  file  The file name
+//--------------------------------------------------------------------------
+void CNetMdDevCache::setFile(const std::string& file)
+{
+    std::unique_lock<std::mutex> lck(smMtx);
+    smFile = file;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      is the cache enabled?
+//!
+//! @return     true if so
+//--------------------------------------------------------------------------
+bool CNetMdDevCache::enabled()
+{
+    std::unique_lock<std::mutex> lck(smMtx);
+    return !smFile.empty();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      look up a device
+//!
+//! @param[in]  key    The device key
+//! @param[out] entry  The cache entry
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdDevCache::lookup(const std::string& key, Entry& entry)
+{
+    std::unique_lock<std::mutex> lck(smMtx);
+    Entries entries;
+
+    if (smFile.empty() || key.empty() || (readFile(entries) != NETMDERR_NO_ERROR))
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    Entries::const_iterator cit = entries.find(clean(key));
+
+    if (cit == entries.cend())
+    {
+        return NETMDERR_OTHER;
+    }
+
+    entry = cit->second;
+    return NETMDERR_NO_ERROR;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      add / update a device
+//!
+//! @param[in]  key    The device key
+//! @param[in]  entry  The cache entry
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdDevCache::store(const std::string& key, const Entry& entry)
+{
+    std::unique_lock<std::mutex> lck(smMtx);
+    Entries entries;
+
+    if (smFile.empty() || key.empty())
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    // a missing file is no error here
+    static_cast<void>(readFile(entries));
+    entries[clean(key)] = entry;
+    return writeFile(entries);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      remove a device
+//!
+//! @param[in]  key    The device key
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdDevCache::drop(const std::string& key)
+{
+    std::unique_lock<std::mutex> lck(smMtx);
+    Entries entries;
+
+    if (smFile.empty() || key.empty() || (readFile(entries) != NETMDERR_NO_ERROR))
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    if (entries.erase(clean(key)) == 0)
+    {
+        return NETMDERR_NO_ERROR;
+    }
+
+    return writeFile(entries);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      read cache file (call with locked mutex)
+//!
+//! @param[out] entries  The entries
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdDevCache::readFile(Entries& entries)
+{
+    std::ifstream ifs(smFile);
+
+    if (!ifs)
+    {
+        return NETMDERR_OTHER;
+    }
+
+    std::string line;
+
+    while (std::getline(ifs, line))
+    {
+        std::istringstream ls(line);
+        std::string key, info, slots, name;
+
+        if (!std::getline(ls, key, '\t') || !std::getline(ls, info, '\t')
+            || !std::getline(ls, slots, '\t'))
+        {
+            mLOG(DEBUG) << "Skip malformed device cache line: " << line;
+            continue;
+        }
+
+        // product name is the rest of the line and might be empty
+        std::getline(ls, name);
+
+        Entry entry;
+        std::istringstream is(info);
+
+        if (!(is >> std::hex >> entry.mDevInfo))
+        {
+            mLOG(DEBUG) << "Skip malformed device cache line: " << line;
+            continue;
+        }
+
+        entry.mName = name;
+
+        std::istringstream ss(slots);
+        std::string slot;
+
+        while (std::getline(ss, slot, ','))
+        {
+            unsigned int pid  = 0;
+            unsigned long addr = 0, data = 0;
+            char c1 = 0, c2 = 0;
+            std::istringstream sis(slot);
+
+            if ((sis >> std::hex >> pid >> c1 >> addr >> c2 >> data) && (c1 == ':') && (c2 == ':'))
+            {
+                entry.mSlots.push_back({static_cast<uint8_t>(pid), static_cast<uint32_t>(addr),
+                                        {static_cast<uint8_t>(data >> 24), static_cast<uint8_t>(data >> 16),
+                                         static_cast<uint8_t>(data >>  8), static_cast<uint8_t>(data)}});
+            }
+        }
+
+        entries[key] = entry;
+    }
+
+    return NETMDERR_NO_ERROR;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write cache file (call with locked mutex)
+//!
+//! @param[in]  entries  The entries
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdDevCache::writeFile(const Entries& entries)
+{
+    std::ofstream ofs(smFile, std::ios_base::out | std::ios_base::trunc);
+
+    if (!ofs)
+    {
+        mLOG(CRITICAL) << "Can't write device cache " << smFile;
+        return NETMDERR_OTHER;
+    }
+
+    for (const auto& [key, entry] : entries)
+    {
+        ofs << key << '\t' << std::hex << entry.mDevInfo << '\t';
+
+        for (size_t i = 0; i < entry.mSlots.size(); i++)
+        {
+            const Slot& s = entry.mSlots.at(i);
+            ofs << (i ? "," : "") << static_cast<int>(s.mPid) << ':' << s.mAddr << ':';
+
+            for (const auto& b : s.mData)
+            {
+                ofs << std::setw(2) << std::setfill('0') << static_cast<int>(b);
+            }
+        }
+
+        ofs << std::dec << '\t' << clean(entry.mName) << '\n';
+    }
+
+    return ofs ? NETMDERR_NO_ERROR : NETMDERR_OTHER;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      make string safe for the cache file
+//!
+//! @param[in]  s     string
+//!
+//! @return     string without tabs and line breaks
+//--------------------------------------------------------------------------
+std::string CNetMdDevCache::clean(const std::string& s)
+{
+    std::string ret = s;
+
+    for (auto& c : ret)
+    {
+        if ((c == '\t') || (c == '\n') || (c == '\r'))
+        {
+            c = ' ';
+        }
+    }
+
+    return ret;
+}
+
+} // ~namespace
@@ -0,0 +1,175 @@
+/*
+ * CNetMdDevCache.h
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/**
+@file CNetMdDevCache.h
+
+# Device cache
+Finding out the firmware version and the patch slot contents of a
+patchable device costs a lot of factory commands (and some seconds).
+This small on-disk cache remembers the results per device, keyed by
+USB serial number or - if the device has none - a fingerprint built
+from vendor / product / release and the USB port path.
+
+The cache is disabled until a file name is set. It is a plain text
+file, one device per line:
+@code
+<key> TAB <device info hex> TAB <slots> TAB <product name>
+@endcode
+Slots are separated by ',', each written as @c pid:addr:data in hex.
+
+Cached data is only a hint: the patch storage is checked against the
+device with one read before it is used. The device info (firmware
+version) is not read back - checking it would cost the very query the
+cache saves. It is trusted as long as key and product name match, so
+drop the entry (or the file) after a firmware update which keeps the
+serial number and the USB release number.
+*/
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "netmd_defines.h"
+
+namespace netmd {
+
+//------------------------------------------------------------------------------
+//! @brief      This class describes a persistent per-device cache.
+//------------------------------------------------------------------------------
+class CNetMdDevCache
+{
+public:
+    /// one cached patch slot
+    struct Slot
+    {
+        uint8_t mPid;               ///< patch id
+        uint32_t mAddr;             ///< patch address
+        NetMDByteVector mData;      ///< patch data
+    };
+
+    /// cached patch slots
+    using Slots = std::vector<Slot>;
+
+    /// one cache entry
+    struct Entry
+    {
+        uint32_t mDevInfo;          ///< Sony device info
+        std::string mName;          ///< product string
+        Slots mSlots;               ///< patch slot contents
+    };
+
+    //--------------------------------------------------------------------------
+    //! @brief      set cache file; an empty name disables the cache
+    //!
+    //! @param[in]  file  The file name
+    //--------------------------------------------------------------------------
+    static void setFile(const std::string& file);
+
+    //--------------------------------------------------------------------------
+    //! @brief      is the cache enabled?
+    //!
+    //! @return     true if so
+    //--------------------------------------------------------------------------
+    static bool enabled();
+
+    //--------------------------------------------------------------------------
+    //! @brief      look up a device
+    //!
+    //! @param[in]  key    The device key
+    //! @param[out] entry  The cache entry
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    static int lookup(const std::string& key, Entry& entry);
+
+    //--------------------------------------------------------------------------
+    //! @brief      add / update a device
+    //!
+    //! @param[in]  key    The device key
+    //! @param[in]  entry  The cache entry
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    static int store(const std::string& key, const Entry& entry);
+
+    //--------------------------------------------------------------------------
+    //! @brief      remove a device
+    //!
+    //! @param[in]  key    The device key
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    static int drop(const std::string& key);
+
+protected:
+    /// all cache entries
+    using Entries = std::map<std::string, Entry>;
+
+    //--------------------------------------------------------------------------
+    //! @brief      read cache file (call with locked mutex)
+    //!
+    //! @param[out] entries  The entries
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    static int readFile(Entries& entries);
+
+    //--------------------------------------------------------------------------
+    //! @brief      write cache file (call with locked mutex)
+    //!
+    //! @param[in]  entries  The entries
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    static int writeFile(const Entries& entries);
+
+    //--------------------------------------------------------------------------
+    //! @brief      make string safe for the cache file
+    //!
+    //! @param[in]  s     string
+    //!
+    //! @return     string without tabs and line breaks
+    //--------------------------------------------------------------------------
+    static std::string clean(const std::string& s);
+
+private:
+    /// cache file name
+    static std::string smFile;
+
+    /// protects cache file
+    static std::mutex smMtx;
+};
+
+} // ~namespace
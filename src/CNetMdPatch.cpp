@@ -28,9 +28,11 @@
  */
 #include "CNetMdPatch.h"
 #include "CNetMdDev.hpp"
+#include "CNetMdDevCache.h"
 #include "log.h"
 #include "netmd_defines.h"
 #include "netmd_utils.h"
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <unistd.h>
@@ -347,6 +349,18 @@ const CNetMdPatch::ExploitPayloadTab CNetMdPatch::smExplPayloadTab =
     }
 };
 
+/// patch reverse index (needs address and payload tables above)
+const CNetMdPatch::PatchRevIdxTab CNetMdPatch::smPatchRevIdxTab = CNetMdPatch::buildPatchRevIdx();
+
+/// UTOC chunk size candidates, largest first (length field is 8 bit)
+const uint8_t CNetMdPatch::smUTOCChunkCand[] = {0xf0, 0x80, 0x40, 0x20, 0x10};
+
+/// probed UTOC chunk sizes
+CNetMdPatch::UTOCChunkTab CNetMdPatch::smUTOCChunkTab;
+
+/// protects the UTOC chunk size table
+std::mutex CNetMdPatch::smMtxUTOCChunk;
+
 //--------------------------------------------------------------------------
 //! @brief      print helper for PatchId
 //!
@@ -418,7 +432,7 @@ std::ostream& operator<<(std::ostream& os, const CNetMdPatch::PatchComplect& pat
 //--------------------------------------------------------------------------
 CNetMdPatch::CNetMdPatch(CNetMdDev& netMd) 
     : mNetMd(netMd), mPatchStorage{{PID_UNUSED, 0, {0,0,0,0}},}, 
-      mPatchStoreValid(false)
+      mPatchStoreValid(false), mUTOCImages{}
 {
 }
 
@@ -433,6 +447,17 @@ void CNetMdPatch::deviceRemoved()
         mPatchStorage[i] = {PID_UNUSED, 0, {0,0,0,0}};
     }
     mPatchStoreValid = false;
+    dropUTOCImages();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      forget known UTOC sector images (the next sector write
+//!             can't skip unchanged blocks)
+//--------------------------------------------------------------------------
+void CNetMdPatch::dropUTOCImages()
+{
+    std::unique_lock<std::recursive_mutex> lck(mNetMd.mMtxDevAcc);
+    mUTOCImages.clear();
 }
 
 //--------------------------------------------------------------------------
@@ -543,48 +568,77 @@ std::optional<CNetMdPatch::PatchId> CNetMdPatch::reverserSearchPatchId(SonyDevIn
         return PID_SAFETY;
     }
 
-    PatchId chk1 = PID_UNUSED, chk2 = PID_UNUSED;
-    
-    for (const auto &[key, value] : smPatchAddrTab)
+    PatchRevIdxTab::const_iterator dit = smPatchRevIdxTab.find(devinfo);
+
+    if ((dit != smPatchRevIdxTab.cend()) && (patch_cnt.size() == 4))
     {
-        PatchAddr::const_iterator cit = value.find(devinfo);
-        if (cit != value.cend())
+        PatchRevIdx::const_iterator pit = dit->second.find(patchRevKey(addr, patch_cnt));
+
+        if (pit != dit->second.cend())
         {
-            if (addr == cit->second)
-            {
-                chk1 = key;
-                break;
-            }
+            return pit->second;
         }
     }
 
-    for (const auto &[key, value] : smPatchPayloadTab)
+    // neither patch data nor patch address found
+    return std::nullopt;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      build the patch reverse index
+//!
+//! @return     reverse index for all devices
+//--------------------------------------------------------------------------
+CNetMdPatch::PatchRevIdxTab CNetMdPatch::buildPatchRevIdx()
+{
+    PatchRevIdxTab tab;
+
+    for (const auto& [pid, addrs] : smPatchAddrTab)
     {
-        for (const auto &[k, v]  : value)
+        // device type is read only, no patch
+        if (pid == PID_DEVTYPE)
+        {
+            continue;
+        }
+
+        // patch 0 variants share one payload
+        const PatchId plpid = ((pid == PID_PATCH_0_A) || (pid == PID_PATCH_0_B)) ? PID_PATCH_0 : pid;
+
+        for (const auto& [dev, addr] : addrs)
         {
-            if ((k & devinfo) && (v == patch_cnt))
+            NetMDByteVector data = patchPayload(dev, plpid);
+
+            if (data.size() != 4)
             {
-                chk2 = key;
-                break;
+                continue;
+            }
+
+            if (pid == PID_TRACK_TYPE)
+            {
+                // mono or stereo, see applySpPatch()
+                data[1] = 4;
+                tab[dev][patchRevKey(addr, data)] = pid;
+                data[1] = 6;
             }
+
+            tab[dev][patchRevKey(addr, data)] = pid;
         }
     }
 
-    if ((chk1 == PID_UNUSED) && (chk2 == PID_UNUSED))
-    {
-        // neither patch data nor patch address found
-        return std::nullopt;
-    }
-    else if ((chk1 != chk2) && !((chk2 == PID_PATCH_0) && ((chk1 == PID_PATCH_0_A) || (chk1 == PID_PATCH_0_B))))
-    {
-        // patch id mismatch
-        mLOG(CRITICAL) << "Patch id mismatch: " << chk1 << " != " << chk2;
-        return std::nullopt;
-    }
-    else
-    {
-        return chk1;
-    }
+    return tab;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      create reverse index key
+//!
+//! @param[in]  addr  The patch address
+//! @param[in]  data  The patch data (4 bytes)
+//!
+//! @return     reverse index key
+//--------------------------------------------------------------------------
+uint64_t CNetMdPatch::patchRevKey(uint32_t addr, const NetMDByteVector& data)
+{
+    return (static_cast<uint64_t>(addr) << 32) | fromLittleEndianByteVector<uint32_t>(data);
 }
 
 //--------------------------------------------------------------------------
@@ -689,26 +743,80 @@ int CNetMdPatch::checkPatch(PatchId pid)
     return 0;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      get cached UTOC chunk size for this device
+//!
+//! @param[in]  write  true -> write size; false -> read size
+//!
+//! @return     chunk size; 0 if not yet probed
+//--------------------------------------------------------------------------
+uint8_t CNetMdPatch::utocChunkSize(bool write)
+{
+    SonyDevInfo devinfo = mNetMd.sonyDevCode();
+    std::unique_lock<std::mutex> lck(smMtxUTOCChunk);
+    UTOCChunkTab::const_iterator it = smUTOCChunkTab.find(devinfo);
+    if (it != smUTOCChunkTab.cend())
+    {
+        return write ? it->second.mWrite : it->second.mRead;
+    }
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      cache probed UTOC chunk size for this device
+//!
+//! @param[in]  write  true -> write size; false -> read size
+//! @param[in]  sz     The chunk size
+//--------------------------------------------------------------------------
+void CNetMdPatch::setUTOCChunkSize(bool write, uint8_t sz)
+{
+    SonyDevInfo devinfo = mNetMd.sonyDevCode();
+    std::unique_lock<std::mutex> lck(smMtxUTOCChunk);
+    UTOCChunkSz& chunk = smUTOCChunkTab[devinfo];
+    (write ? chunk.mWrite : chunk.mRead) = sz;
+    mLOG(DEBUG) << "UTOC " << (write ? "write" : "read") << " chunk size for "
+                << devinfo << ": " << static_cast<int>(sz);
+}
+
 //--------------------------------------------------------------------------
 //! @brief      Reads an utoc sector.
 //!
+//! The chunk size is probed on first use: starting with the largest
+//! candidate, the first request is retried with smaller chunks until the
+//! device answers with the full length. The result is cached per device.
+//!
 //! @param[in]  s     sector name
 //!
 //! @return     TOC sector data. (error if empty)
 //--------------------------------------------------------------------------
 NetMDByteVector CNetMdPatch::readUTOCSector(UTOCSector s)
 {
-    constexpr uint16_t RD_SIZE = 0x10;
     NetMDByteVector ret, part;
+    uint8_t chunk = utocChunkSize(false);
+    bool probe = (chunk == 0);
+    size_t cand = 0;
+
+    if (probe)
+    {
+        chunk = smUTOCChunkCand[cand];
+    }
 
-    for (int i = 0; i < 147; i++)
+    while (ret.size() < UTOC_SECT_SZ)
     {
-        // 147 * 16 = 2352 -> sector length
-        part = mNetMd.readMetadataPeripheral(s, i * RD_SIZE, RD_SIZE);
-        if (!part.empty())
+        uint8_t len = static_cast<uint8_t>(std::min<size_t>(chunk, UTOC_SECT_SZ - ret.size()));
+        part = mNetMd.readMetadataPeripheral(s, ret.size(), len);
+        if (part.size() == len)
         {
             ret += part;
-            // mLOG(INFO) << "Read part of " << part.size() << " Bytes, sector is now " << ret.size() << " Bytes";
+            if (probe)
+            {
+                setUTOCChunkSize(false, chunk);
+                probe = false;
+            }
+        }
+        else if (probe && (++cand < sizeof(smUTOCChunkCand)))
+        {
+            chunk = smUTOCChunkCand[cand];
         }
         else
         {
@@ -717,6 +825,7 @@ NetMDByteVector CNetMdPatch::readUTOCSector(UTOCSector s)
         }
     }
 
+    mUTOCImages[s] = ret;
     mLOG(INFO) << "Sector " << static_cast<int>(s) << LOG::hexFormat(INFO, ret);
     return ret;
 }
@@ -724,6 +833,11 @@ NetMDByteVector CNetMdPatch::readUTOCSector(UTOCSector s)
 //--------------------------------------------------------------------------
 //! @brief      Writes an utoc sector.
 //!
+//! The chunk size is probed the same way as for reading, using the
+//! data which has to be written anyway. If we know the sector image on
+//! the device, only blocks which differ are written. Neighbouring dirty
+//! blocks are merged up to the chunk size.
+//!
 //! @param[in]  s     sector names
 //! @param[in]  data  The data to be written
 //!
@@ -733,22 +847,77 @@ NetMDByteVector CNetMdPatch::readUTOCSector(UTOCSector s)
 int CNetMdPatch::writeUTOCSector(UTOCSector s, const NetMDByteVector& data)
 {
     int err = 0;
-    constexpr uint16_t WR_SIZE = 0x10;
-    if (data.size() !=  2352)
+    if (data.size() != UTOC_SECT_SZ)
     {
         mLOG(CRITICAL) << "The TOC data provided is not a valid TOC Sector!";
         return NETMDERR_PARAM;
     }
 
-    for (int i = 0; i < 147; i++)
+    const NetMDByteVector* pImg = nullptr;
+    UTOCImages::const_iterator it = mUTOCImages.find(s);
+    if ((it != mUTOCImages.cend()) && (it->second.size() == UTOC_SECT_SZ))
+    {
+        pImg = &it->second;
+    }
+
+    auto dirty = [&](size_t offset)
     {
-        if ((err = mNetMd.writeMetadataPeripheral(s, i * WR_SIZE, subVec(data, i * WR_SIZE, WR_SIZE))) != NETMDERR_NO_ERROR)
+        return (pImg == nullptr)
+            || !std::equal(data.begin() + offset, data.begin() + offset + UTOC_BLOCK_SZ,
+                           pImg->begin() + offset);
+    };
+
+    uint8_t chunk = utocChunkSize(true);
+    bool probe = (chunk == 0);
+    size_t cand = 0;
+    size_t offset = 0;
+    int cmds = 0;
+
+    if (probe)
+    {
+        chunk = smUTOCChunkCand[cand];
+    }
+
+    while (offset < UTOC_SECT_SZ)
+    {
+        if (!dirty(offset))
+        {
+            offset += UTOC_BLOCK_SZ;
+            continue;
+        }
+
+        size_t len = UTOC_BLOCK_SZ;
+        while (((offset + len) < UTOC_SECT_SZ) && ((len + UTOC_BLOCK_SZ) <= chunk) && dirty(offset + len))
+        {
+            len += UTOC_BLOCK_SZ;
+        }
+
+        if ((err = mNetMd.writeMetadataPeripheral(s, offset, subVec(data, offset, len))) == NETMDERR_NO_ERROR)
+        {
+            offset += len;
+            cmds++;
+
+            // only a full chunk proves the chunk size
+            if (probe && (len == chunk))
+            {
+                setUTOCChunkSize(true, chunk);
+                probe = false;
+            }
+        }
+        else if (probe && (++cand < sizeof(smUTOCChunkCand)))
+        {
+            chunk = smUTOCChunkCand[cand];
+        }
+        else
         {
             mLOG(CRITICAL) << "Can't write TOC data for sector " << static_cast<int>(s);
+            mUTOCImages.erase(s);
             return err;
         }
     }
 
+    mLOG(DEBUG) << "Sector " << static_cast<int>(s) << " written using " << cmds << " command(s).";
+    mUTOCImages[s] = data;
     return NETMDERR_NO_ERROR;
 }
 
@@ -913,14 +1082,19 @@ bool CNetMdPatch::checkUSBExec(const SonyDevInfo& devcode)
 //--------------------------------------------------------------------------
 //! @brief      finalize TOC though exploit
 //!
-//! @param[in]  reset  do device reset if true
+//! @param[in]  reset     do device reset if true
+//! @param[in]  progress  optional progress callback
 //!
 //! @return     NetMdErr
 //! @see        NetMdErr
 //--------------------------------------------------------------------------
-int CNetMdPatch::finalizeTOC(bool reset)
+int CNetMdPatch::finalizeTOC(bool reset, const ProgressCallback& progress)
 {
     mFLOW(INFO);
+
+    // TOC edit session ends here; next write compares against a fresh read
+    dropUTOCImages();
+
     try
     {
         SonyDevInfo devcode = mNetMd.sonyDevCode();
@@ -929,7 +1103,7 @@ int CNetMdPatch::finalizeTOC(bool reset)
             mNetMdThrow(NETMDERR_OTHER, "Unknown or unsupported NetMD device!");
         }
 
-        mLOG(CAPTURE) << "Finalizing TOC: 00%";
+        tocProgress(progress, 0);
 
         if (USBExecute(devcode, exploitData(devcode, EID_LOWER_HEAD)) != NETMDERR_NO_ERROR)
         {
@@ -937,23 +1111,15 @@ int CNetMdPatch::finalizeTOC(bool reset)
         }
         mLOG(DEBUG) << "Lower head success!";
 
-        for(int i = 1; i <= 5; i++)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(250));
-            mLOG(CAPTURE) << "Finalizing TOC: " << std::setw(2) << std::setfill('0') << i << "%";
-        }
-        
+        waitTOCStep(1'250, 1, 5, progress);
+
         if (USBExecute(devcode, exploitData(devcode, EID_TRIGGER)) != NETMDERR_NO_ERROR)
         {
             mNetMdThrow(NETMDERR_OTHER, "Exploit 'trigger' failed!");
         }
         mLOG(DEBUG) << "Trigger success!";
 
-        for(int i = 6; i <= 89; i++)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(250));
-            mLOG(CAPTURE) << "Finalizing TOC: " << std::setw(2) << std::setfill('0') << i << "%";
-        }
+        waitTOCStep(21'000, 6, 89, progress);
 
         if (USBExecute(devcode, exploitData(devcode, EID_RAISE_HEAD)) != NETMDERR_NO_ERROR)
         {
@@ -970,7 +1136,7 @@ int CNetMdPatch::finalizeTOC(bool reset)
             mLOG(DEBUG) << "Device reset success!";
         }
 
-        mLOG(CAPTURE) << "Finalizing TOC: 90%";
+        tocProgress(progress, 90);
     }
     catch(const ThrownData& e)
     {
@@ -986,6 +1152,88 @@ int CNetMdPatch::finalizeTOC(bool reset)
     return NETMDERR_NO_ERROR;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      wait for one finalize TOC step: poll the operating status
+//!             until the device was busy and is ready again; if the
+//!             status can't be read, wait until the deadline
+//!
+//! @param[in]  maxMs     deadline in milliseconds
+//! @param[in]  from      progress at start
+//! @param[in]  to        progress at end
+//! @param[in]  progress  progress callback (may be empty)
+//--------------------------------------------------------------------------
+void CNetMdPatch::waitTOCStep(int maxMs, int from, int to, const ProgressCallback& progress)
+{
+    constexpr int POLL_MS = 250;
+    bool busySeen = false;
+    int  lastPct  = -1;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int elapsed = 0; elapsed < maxMs; )
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        int status = mNetMd.operatingStatus();
+
+        if (status < 0)
+        {
+            // device can't tell -> fixed wait as before, no more polling
+            mLOG(DEBUG) << "Can't read operating status (" << status << "), wait "
+                        << (maxMs - std::min(elapsed, maxMs)) << " ms.";
+
+            if (elapsed < maxMs)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(maxMs - elapsed));
+            }
+            break;
+        }
+        else if (status == CNetMdDev::NETMD_OPSTAT_READY)
+        {
+            if (busySeen)
+            {
+                mLOG(DEBUG) << "Device ready after " << elapsed << " ms.";
+                break;
+            }
+        }
+        else
+        {
+            busySeen = true;
+        }
+
+        int pct = from + (to - from) * std::min(elapsed, maxMs) / maxMs;
+
+        if (pct != lastPct)
+        {
+            tocProgress(progress, pct);
+            lastPct = pct;
+        }
+    }
+
+    if (lastPct != to)
+    {
+        tocProgress(progress, to);
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      report TOC progress (callback or log)
+//!
+//! @param[in]  progress  progress callback (may be empty)
+//! @param[in]  percent   The progress in percent
+//--------------------------------------------------------------------------
+void CNetMdPatch::tocProgress(const ProgressCallback& progress, int percent)
+{
+    if (progress)
+    {
+        progress(percent);
+    }
+    else
+    {
+        mLOG(CAPTURE) << "Finalizing TOC: " << std::setw(2) << std::setfill('0') << percent << "%";
+    }
+}
+
 //--------------------------------------------------------------------------
 //! @brief      Reads a patch data.
 //!
@@ -1003,11 +1251,13 @@ int CNetMdPatch::readPatchData(int patchNo, uint32_t& addr, NetMDByteVector& pat
     const uint32_t base  = PERIPHERAL_BASE + patchNo * 0x10;
     NetMDByteVector reply;
 
-    if ((mNetMd.cleanRead(base + 4, 4, reply) == NETMDERR_NO_ERROR) && (reply.size() == 4))
+    CNetMdDev::MemSession ms(mNetMd, base + 4, 8, CNetMdDev::NETMD_MEM_READ);
+
+    if ((ms.read(base + 4, 4, reply) == NETMDERR_NO_ERROR) && (reply.size() == 4))
     {
         addr = fromLittleEndianByteVector<uint32_t>(reply);
 
-        if ((mNetMd.cleanRead(base + 8, 4, patch) != NETMDERR_NO_ERROR) || (patch.size() != 4))
+        if ((ms.read(base + 8, 4, patch) != NETMDERR_NO_ERROR) || (patch.size() != 4))
         {
             ret = NETMDERR_USB;
         }
@@ -1031,6 +1281,7 @@ int CNetMdPatch::patch(const PatchComplect& pc)
     if ((ret = patch(pc.mAddr, pc.mPatchData, pc.mNextFreePatch)) == NETMDERR_NO_ERROR)
     {
         mPatchStorage[pc.mNextFreePatch] = { pc.mPid, pc.mAddr, pc.mPatchData };
+        cachePatchStorage();
     }
     return ret;
 }
@@ -1058,7 +1309,7 @@ int CNetMdPatch::patch(uint32_t addr, const NetMDByteVector& data, int patchNo)
 
         int iMaxPatches = maxPatches();
 
-        if ((iMaxPatches < 0) || (patchNo < 0) || (patchNo >= maxPatches()))
+        if ((iMaxPatches < 0) || (patchNo < 0) || (patchNo >= iMaxPatches))
         {
             mNetMdThrow(NETMDERR_PARAM, "Error with patch number(s)!");
         }
@@ -1066,99 +1317,177 @@ int CNetMdPatch::patch(uint32_t addr, const NetMDByteVector& data, int patchNo)
         const uint32_t base    = PERIPHERAL_BASE + patchNo   * 0x10;
         const uint32_t control = PERIPHERAL_BASE + iMaxPatches * 0x10;
 
-        NetMDByteVector reply;
-
-        // Write 5, 12 to main control
-        if (mNetMd.cleanWrite(control, {5}) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #1.");
-        }
-
-        if (mNetMd.cleanWrite(control, {12}) != NETMDERR_NO_ERROR)
+        // with active USB code execution the whole
+        // sequence runs on the device in one go
+        if (usbExecActive())
         {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #2.");
+            if (patchExec(base, control, addr, data) == NETMDERR_NO_ERROR)
+            {
+                return NETMDERR_NO_ERROR;
+            }
+            mLOG(DEBUG) << "Batched patch through USB execution failed, use memory access!";
         }
 
-        // AND 0xFE with patch control
-        if ((mNetMd.cleanRead(base, 4, reply) != NETMDERR_NO_ERROR) || (reply.size() != 4))
+        if (patchMem(base, control, addr, data) != NETMDERR_NO_ERROR)
         {
-            mNetMdThrow(NETMDERR_USB, "Error while reading patch control #1.");
+            mNetMdThrow(NETMDERR_USB, "Error while writing patch slot #" << patchNo << ".");
         }
+    }
+    catch(const ThrownData& e)
+    {
+        LOG(CRITICAL) << e.mErrDescr;
+        return e.mErr;
+    }
+    catch(...)
+    {
+        mLOG(CRITICAL) << "Unknown error while patching NetMD Device!";
+        return NETMDERR_OTHER;
+    }
 
-        reply[0] &= 0xfe;
-
-        if (mNetMd.cleanWrite(base, reply) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing patch control #1.");
-        }
+    return NETMDERR_NO_ERROR;
+}
 
-        // AND 0xFD with patch control
-        if ((mNetMd.cleanRead(base, 4, reply) != NETMDERR_NO_ERROR) || (reply.size() != 4))
+//--------------------------------------------------------------------------
+//! @brief      is the USB execution patch installed?
+//!             (checks patch storage only, no device access)
+//!
+//! @return     true if installed, false if not
+//--------------------------------------------------------------------------
+bool CNetMdPatch::usbExecActive() const
+{
+    for (int i = 0; i < MAX_PATCH; i++)
+    {
+        if (mPatchStorage[i].mPid == PID_USB_EXE)
         {
-            mNetMdThrow(NETMDERR_USB, "Error while reading patch control #2.");
+            return true;
         }
+    }
+    return false;
+}
 
-        reply[0] &= 0xfd;
-
-        if (mNetMd.cleanWrite(base, reply) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing patch control #2.");
-        }
+//--------------------------------------------------------------------------
+//! @brief      program a patch slot through memory access, opening
+//!             each memory region only once
+//!
+//! @param[in]  base     The patch slot base address
+//! @param[in]  control  The main control address
+//! @param[in]  addr     The patch address
+//! @param[in]  data     The patch data
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdPatch::patchMem(uint32_t base, uint32_t control, uint32_t addr, const NetMDByteVector& data)
+{
+    mFLOW(DEBUG);
+    int ret = NETMDERR_NO_ERROR;
+    NetMDByteVector ctrl, slot = toLittleEndianByteVector(addr);
+    slot += data;
 
-        if ((reply = toLittleEndianByteVector(addr)).size() != sizeof(addr))
+    {
+        // Write 5, 12 to main control
+        CNetMdDev::MemSession ms(mNetMd, control, 1, CNetMdDev::NETMD_MEM_WRITE);
+        if ((ms.write(control, {5}) != NETMDERR_NO_ERROR)
+            || (ms.write(control, {12}) != NETMDERR_NO_ERROR))
         {
-            mNetMdThrow(NETMDERR_USB, "Error converting address into little endian byte vector.");
+            ret = NETMDERR_USB;
         }
+    }
 
-        // Write patch address
-        if (mNetMd.cleanWrite(base + 4, reply) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing patch address.");
-        }
+    if (ret == NETMDERR_NO_ERROR)
+    {
+        CNetMdDev::MemSession ms(mNetMd, base, 0x0c, CNetMdDev::NETMD_MEM_READ_WRITE);
 
-        // Write patch VALUE
-        if (mNetMd.cleanWrite(base + 8, data) != NETMDERR_NO_ERROR)
+        // read patch control only once
+        if ((ms.read(base, 4, ctrl) != NETMDERR_NO_ERROR) || (ctrl.size() != 4))
         {
-            mNetMdThrow(NETMDERR_USB, "Error while writing patch data.");
+            ret = NETMDERR_USB;
         }
-
-        // OR 1 with patch control
-        if ((mNetMd.cleanRead(base, 4, reply) != NETMDERR_NO_ERROR) || (reply.size() != 4))
+        else
         {
-            mNetMdThrow(NETMDERR_USB, "Error while reading patch control #3.");
+            // disable slot, then address and value in one write
+            ctrl[0] &= 0xfc;
+            if ((ms.write(base, ctrl) != NETMDERR_NO_ERROR)
+                || (ms.write(base + 4, slot) != NETMDERR_NO_ERROR))
+            {
+                ret = NETMDERR_USB;
+            }
+            else
+            {
+                // OR 1 with patch control
+                ctrl[0] |= 0x01;
+                if (ms.write(base, ctrl) != NETMDERR_NO_ERROR)
+                {
+                    ret = NETMDERR_USB;
+                }
+            }
         }
+    }
 
-        reply[0] |= 0x01;
-
-        if (mNetMd.cleanWrite(base, reply) != NETMDERR_NO_ERROR)
+    {
+        // write 5, 9 to main control - even on error
+        CNetMdDev::MemSession ms(mNetMd, control, 1, CNetMdDev::NETMD_MEM_WRITE);
+        if ((ms.write(control, {5}) != NETMDERR_NO_ERROR)
+            || (ms.write(control, {9}) != NETMDERR_NO_ERROR))
         {
-            mNetMdThrow(NETMDERR_USB, "Error while writing patch control #3.");
+            ret = NETMDERR_USB;
         }
+    }
 
-        // write 5, 9 to main control
-        if (mNetMd.cleanWrite(control, {5}) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #3.");
-        }
+    return ret;
+}
 
-        if (mNetMd.cleanWrite(control, {9}) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #4.");
-        }
+//--------------------------------------------------------------------------
+//! @brief      program a patch slot with one USB execution payload
+//!
+//! @param[in]  base     The patch slot base address
+//! @param[in]  control  The main control address
+//! @param[in]  addr     The patch address
+//! @param[in]  data     The patch data
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdPatch::patchExec(uint32_t base, uint32_t control, uint32_t addr, const NetMDByteVector& data)
+{
+    mFLOW(DEBUG);
+    SonyDevInfo devcode = mNetMd.sonyDevCode();
 
-    }
-    catch(const ThrownData& e)
+    if ((devcode == SDI(UNKNOWN)) || (devcode == SDI(NO_SUPPORT)))
     {
-        LOG(CRITICAL) << e.mErrDescr;
-        return e.mErr;
-    }
-    catch(...)
-    {
-        mLOG(CRITICAL) << "Unknown error while patching NetMD Device!";
-        return NETMDERR_OTHER;
+        return NETMDERR_NOT_SUPPORTED;
     }
 
-    return NETMDERR_NO_ERROR;
+    // ARM code, literal pool follows at offset 0x50
+    NetMDByteVector payload = {
+        0x48, 0x20, 0x9f, 0xe5, // 00: ldr  r2, [pc, #0x48]  ; r2 = control
+        0x48, 0x30, 0x9f, 0xe5, // 04: ldr  r3, [pc, #0x48]  ; r3 = base
+        0x05, 0x00, 0xa0, 0xe3, // 08: mov  r0, #5
+        0x00, 0x00, 0xc2, 0xe5, // 0c: strb r0, [r2]
+        0x0c, 0x00, 0xa0, 0xe3, // 10: mov  r0, #12
+        0x00, 0x00, 0xc2, 0xe5, // 14: strb r0, [r2]
+        0x00, 0x10, 0x93, 0xe5, // 18: ldr  r1, [r3]
+        0x03, 0x10, 0xc1, 0xe3, // 1c: bic  r1, r1, #3
+        0x00, 0x10, 0x83, 0xe5, // 20: str  r1, [r3]
+        0x2c, 0x00, 0x9f, 0xe5, // 24: ldr  r0, [pc, #0x2c]  ; r0 = patch address
+        0x04, 0x00, 0x83, 0xe5, // 28: str  r0, [r3, #4]
+        0x28, 0x00, 0x9f, 0xe5, // 2c: ldr  r0, [pc, #0x28]  ; r0 = patch value
+        0x08, 0x00, 0x83, 0xe5, // 30: str  r0, [r3, #8]
+        0x01, 0x10, 0x81, 0xe3, // 34: orr  r1, r1, #1
+        0x00, 0x10, 0x83, 0xe5, // 38: str  r1, [r3]
+        0x05, 0x00, 0xa0, 0xe3, // 3c: mov  r0, #5
+        0x00, 0x00, 0xc2, 0xe5, // 40: strb r0, [r2]
+        0x09, 0x00, 0xa0, 0xe3, // 44: mov  r0, #9
+        0x00, 0x00, 0xc2, 0xe5, // 48: strb r0, [r2]
+        0x1e, 0xff, 0x2f, 0xe1, // 4c: bx   lr
+    };
+
+    payload += toLittleEndianByteVector(control);
+    payload += toLittleEndianByteVector(base);
+    payload += toLittleEndianByteVector(addr);
+    payload += data;
+
+    return USBExecute(devcode, payload);
 }
 
 //--------------------------------------------------------------------------
@@ -1248,47 +1577,40 @@ int CNetMdPatch::unpatchIdx(int idx)
 
         NetMDByteVector reply;
 
-        // Write 5, 12 to main control
-        if (mNetMd.cleanWrite(control, {5}) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #1.");
-        }
-
-        if (mNetMd.cleanWrite(control, {12}) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #2.");
-        }
-
-        // AND 0xFE with patch control
-        if ((mNetMd.cleanRead(base, 4, reply) != NETMDERR_NO_ERROR) || (reply.size() != 4))
         {
-            mNetMdThrow(NETMDERR_USB, "Error while reading patch control #1.");
+            // Write 5, 12 to main control
+            CNetMdDev::MemSession ms(mNetMd, control, 1, CNetMdDev::NETMD_MEM_WRITE);
+            if ((ms.write(control, {5}) != NETMDERR_NO_ERROR)
+                || (ms.write(control, {12}) != NETMDERR_NO_ERROR))
+            {
+                mNetMdThrow(NETMDERR_USB, "Error while writing main control #1.");
+            }
         }
 
-        reply[0] &= 0xfe;
-
-        if (mNetMd.cleanWrite(base, reply) != NETMDERR_NO_ERROR)
         {
-            mNetMdThrow(NETMDERR_USB, "Error while writing patch control #1.");
-        }
+            // AND 0xFE with patch control
+            CNetMdDev::MemSession ms(mNetMd, base, 4, CNetMdDev::NETMD_MEM_READ_WRITE);
+            if ((ms.read(base, 4, reply) != NETMDERR_NO_ERROR) || (reply.size() != 4))
+            {
+                mNetMdThrow(NETMDERR_USB, "Error while reading patch control #1.");
+            }
 
-        /*
-        // clean entry
-        if (mNetMd.cleanWrite(base + 4, {0, 0, 0, 0, 0, 0, 0, 0}) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while cleaning patch info.");
-        }
-        */
+            reply[0] &= 0xfe;
 
-        // write 5, 9 to main control
-        if (mNetMd.cleanWrite(control, {5}) != NETMDERR_NO_ERROR)
-        {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #3.");
+            if (ms.write(base, reply) != NETMDERR_NO_ERROR)
+            {
+                mNetMdThrow(NETMDERR_USB, "Error while writing patch control #1.");
+            }
         }
 
-        if (mNetMd.cleanWrite(control, {9}) != NETMDERR_NO_ERROR)
         {
-            mNetMdThrow(NETMDERR_USB, "Error while writing main control #4.");
+            // write 5, 9 to main control
+            CNetMdDev::MemSession ms(mNetMd, control, 1, CNetMdDev::NETMD_MEM_WRITE);
+            if ((ms.write(control, {5}) != NETMDERR_NO_ERROR)
+                || (ms.write(control, {9}) != NETMDERR_NO_ERROR))
+            {
+                mNetMdThrow(NETMDERR_USB, "Error while writing main control #2.");
+            }
         }
     }
     catch(const ThrownData& e)
@@ -1303,6 +1625,7 @@ int CNetMdPatch::unpatchIdx(int idx)
     }
 
     mPatchStorage[idx] = {PID_UNUSED, 0, {0,0,0,0}};
+    cachePatchStorage();
     return NETMDERR_NO_ERROR;
 }
 
@@ -1462,13 +1785,31 @@ int CNetMdPatch::applySpPatch(int chanNo)
             }
         }
 
+        const uint8_t trackType = (chanNo == 1) ? 4 : 6; // mono or stereo
+
+        // a track type patch left from an earlier upload (or taken
+        // from device cache) might carry the other mode
+        for (int i = 0; i < maxPatches(); i++)
+        {
+            if ((mPatchStorage[i].mPid == PID_TRACK_TYPE) && (mPatchStorage[i].mPatchData.size() > 1)
+                && (mPatchStorage[i].mPatchData[1] != trackType))
+            {
+                mLOG(INFO) << "Track type patch has wrong mode, re-patch it.";
+                if (unpatch({PID_TRACK_TYPE}) != NETMDERR_NO_ERROR)
+                {
+                    mNetMdThrow(NETMDERR_USB, "Can't undo stale track type patch!");
+                }
+                break;
+            }
+        }
+
         if (!checkPatch(PID_TRACK_TYPE))
         {
             if (fillPatchComplect(PID_TRACK_TYPE, devcode, pc) != NETMDERR_NO_ERROR)
             {
                 mNetMdThrow(NETMDERR_NOT_SUPPORTED, "Can't find patch data track type!");
             }
-            pc.mPatchData[1] = (chanNo == 1) ? 4 : 6; // mono or stereo
+            pc.mPatchData[1] = trackType;
             if (patch(pc) != NETMDERR_NO_ERROR)
             {
                 mNetMdThrow(NETMDERR_USB, "Can't track type patch!");
@@ -1786,35 +2127,192 @@ void CNetMdPatch::updatePatchStorage()
         return;
     }
 
-    NetMDByteVector patch_data{0,0,0,0};
-    uint32_t        patch_addr = 0;
-        
-    for (int i = 0; i < maxPatches(); i++)
+    // patch memory access needs factory mode
+    static_cast<void>(mNetMd.enableFactory(mNetMd.mDevice.mFactoryMode));
+
+    if (patchStorageFromCache())
     {
-        patch(patch_addr, patch_data, i);
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        
-        unpatchIdx(i);
+        mPatchStoreValid = true;
+        return;
+    }
 
-        /*
-        if (readPatchData(i, patch_addr, patch_data) == NETMDERR_NO_ERROR)
+    if (discoverPatches() != NETMDERR_NO_ERROR)
+    {
+        mLOG(DEBUG) << "Read-only patch discovery failed, clear all patch slots!";
+
+        NetMDByteVector patch_data{0,0,0,0};
+        uint32_t        patch_addr = 0;
+
+        for (int i = 0; i < maxPatches(); i++)
         {
-            if (auto pid = reverserSearchPatchId(mNetMd.sonyDevCode(), patch_addr, patch_data))
-            {
-                mLOG(INFO) << "Found patch " << pid.value() << " at index " << i;
-                mPatchStorage[i] = { pid.value(), patch_addr, patch_data };
-            }
-            else
-            {
-                unpatchIdx(i);
-            }
+            patch(patch_addr, patch_data, i);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            unpatchIdx(i);
         }
-        */
     }
-    safetyPatch();
 
+    // mark valid before safety patch, it checks the patch storage
     mPatchStoreValid = true;
+    safetyPatch();
+    cachePatchStorage();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      read control, address and value of all patch slots at once
+//!
+//! @param[out] regs  The patch slot registers (0x10 bytes per slot)
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdPatch::readPatchSlots(NetMDByteVector& regs)
+{
+    mFLOW(DEBUG);
+    const int slots = maxPatches();
+
+    if (slots <= 0)
+    {
+        return NETMDERR_NOT_SUPPORTED;
+    }
+
+    if ((mNetMd.cleanRead(PERIPHERAL_BASE, slots * 0x10, regs) != NETMDERR_NO_ERROR)
+        || (regs.size() != static_cast<size_t>(slots * 0x10)))
+    {
+        mLOG(DEBUG) << "Can't read patch slots!";
+        return NETMDERR_USB;
+    }
+
+    return NETMDERR_NO_ERROR;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      rebuild patch storage from the patch slots on the device
+//!             without writing known patches
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdPatch::discoverPatches()
+{
+    mFLOW(INFO);
+    NetMDByteVector regs;
+
+    if (readPatchSlots(regs) != NETMDERR_NO_ERROR)
+    {
+        return NETMDERR_USB;
+    }
+
+    const SonyDevInfo devinfo = mNetMd.sonyDevCode();
+
+    for (int i = 0; i < maxPatches(); i++)
+    {
+        mPatchStorage[i] = {PID_UNUSED, 0, {0,0,0,0}};
+
+        // slot disabled
+        if (!(regs.at(i * 0x10) & 0x01))
+        {
+            continue;
+        }
+
+        uint32_t        patch_addr = fromLittleEndianByteVector<uint32_t>(subVec(regs, i * 0x10 + 4, 4));
+        NetMDByteVector patch_data = subVec(regs, i * 0x10 + 8, 4);
+
+        if (auto pid = reverserSearchPatchId(devinfo, patch_addr, patch_data))
+        {
+            mLOG(INFO) << "Found patch " << pid.value() << " at index " << i;
+            mPatchStorage[i] = { pid.value(), patch_addr, patch_data };
+        }
+        else
+        {
+            mLOG(INFO) << "Unknown patch at index " << i << ", unpatch it.";
+            unpatchIdx(i);
+        }
+    }
+
+    return NETMDERR_NO_ERROR;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      take patch storage from device cache, if all patch slots
+//!             on the device still match (one read)
+//!
+//! @return     true if patch storage was taken from cache
+//--------------------------------------------------------------------------
+bool CNetMdPatch::patchStorageFromCache()
+{
+    mFLOW(INFO);
+    CNetMdDevCache::Entry entry;
+    NetMDByteVector regs;
+    const int slots = maxPatches();
+
+    if ((slots <= 0)
+        || (CNetMdDevCache::lookup(mNetMd.mDevice.mCacheKey, entry) != NETMDERR_NO_ERROR)
+        || (entry.mDevInfo != mNetMd.sonyDevCode())
+        || (entry.mSlots.size() != static_cast<size_t>(slots)))
+    {
+        return false;
+    }
+
+    // one read over all patch slots: control, address, value
+    if (readPatchSlots(regs) != NETMDERR_NO_ERROR)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < slots; i++)
+    {
+        const CNetMdDevCache::Slot& slot = entry.mSlots.at(i);
+        const bool active = !!(regs.at(i * 0x10) & 0x01);
+        bool match;
+
+        if (slot.mPid == PID_UNUSED)
+        {
+            match = !active;
+        }
+        else
+        {
+            match = active && (slot.mPid <= PID_PCM_SPEEDUP_2)
+                && (fromLittleEndianByteVector<uint32_t>(subVec(regs, i * 0x10 + 4, 4)) == slot.mAddr)
+                && (subVec(regs, i * 0x10 + 8, 4) == slot.mData);
+        }
+
+        if (!match)
+        {
+            mLOG(DEBUG) << "Patch slot #" << i << " doesn't match device cache!";
+            return false;
+        }
+    }
+
+    for (int i = 0; i < slots; i++)
+    {
+        const CNetMdDevCache::Slot& slot = entry.mSlots.at(i);
+        mPatchStorage[i] = {static_cast<PatchId>(slot.mPid), slot.mAddr, slot.mData};
+    }
+
+    mLOG(INFO) << "Patch storage taken from device cache.";
+    return true;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write patch storage to device cache
+//--------------------------------------------------------------------------
+void CNetMdPatch::cachePatchStorage()
+{
+    if (!mPatchStoreValid || !CNetMdDevCache::enabled())
+    {
+        return;
+    }
+
+    CNetMdDevCache::Entry entry = {mNetMd.sonyDevCode(), mNetMd.mDevice.mName, {}};
+
+    for (int i = 0; i < maxPatches(); i++)
+    {
+        entry.mSlots.push_back({mPatchStorage[i].mPid, mPatchStorage[i].mAddr, mPatchStorage[i].mPatchData});
+    }
+
+    static_cast<void>(CNetMdDevCache::store(mNetMd.mDevice.mCacheKey, entry));
 }
 
 } // ~namespace
@@ -30,6 +30,8 @@
 #include "CNetMdDev.hpp"
 #include "netmd_defines.h"
 #include <cstdint>
+#include <map>
+#include <mutex>
 #include <optional>
 
 namespace netmd {
@@ -46,6 +48,8 @@ class CNetMdPatch
 
     static constexpr uint32_t PERIPHERAL_BASE = 0x03802000;
     static constexpr uint8_t  MAX_PATCH       = 16; ///< HiMD supports up to 16
+    static constexpr uint16_t UTOC_SECT_SZ    = 2352; ///< size of one UTOC sector
+    static constexpr uint16_t UTOC_BLOCK_SZ   = 0x10; ///< UTOC compare block size
 
     /// patch IDs
     enum PatchId : uint8_t
@@ -151,6 +155,54 @@ class CNetMdPatch
     /// exmploit command lookup
     static const ExploitCmds smExploidCmds;
 
+    /// UTOC transfer chunk sizes (0 -> not yet probed)
+    struct UTOCChunkSz
+    {
+        uint8_t mRead;
+        uint8_t mWrite;
+    };
+
+    /// UTOC chunk sizes per device
+    using UTOCChunkTab = std::map<SonyDevInfo, UTOCChunkSz>;
+
+    /// chunk size candidates for UTOC transfers, largest first
+    static const uint8_t smUTOCChunkCand[];
+
+    /// probed UTOC chunk sizes
+    static UTOCChunkTab smUTOCChunkTab;
+
+    /// last known UTOC sector images
+    using UTOCImages = std::map<UTOCSector, NetMDByteVector>;
+
+    /// protects the UTOC chunk size table
+    static std::mutex smMtxUTOCChunk;
+
+    /// reverse index: (patch address << 32 | patch value) -> patch id
+    using PatchRevIdx    = std::map<uint64_t, PatchId>;
+
+    /// reverse index per device
+    using PatchRevIdxTab = std::map<SonyDevInfo, PatchRevIdx>;
+
+    /// reverse index, built from patch address and payload tables
+    static const PatchRevIdxTab smPatchRevIdxTab;
+
+    //--------------------------------------------------------------------------
+    //! @brief      build the patch reverse index
+    //!
+    //! @return     reverse index for all devices
+    //--------------------------------------------------------------------------
+    static PatchRevIdxTab buildPatchRevIdx();
+
+    //--------------------------------------------------------------------------
+    //! @brief      create reverse index key
+    //!
+    //! @param[in]  addr  The patch address
+    //! @param[in]  data  The patch data (4 bytes)
+    //!
+    //! @return     reverse index key
+    //--------------------------------------------------------------------------
+    static uint64_t patchRevKey(uint32_t addr, const NetMDByteVector& data);
+
     //--------------------------------------------------------------------------
     //! @brief      Constructs a new instance.
     //!
@@ -163,6 +215,12 @@ class CNetMdPatch
     //--------------------------------------------------------------------------
     void deviceRemoved();
 
+    //--------------------------------------------------------------------------
+    //! @brief      forget known UTOC sector images (the next sector write
+    //!             can't skip unchanged blocks)
+    //--------------------------------------------------------------------------
+    void dropUTOCImages();
+
     //--------------------------------------------------------------------------
     //! @brief      get number of max patches
     //!
@@ -257,6 +315,23 @@ class CNetMdPatch
     //--------------------------------------------------------------------------
     int writeUTOCSector(UTOCSector s, const NetMDByteVector& data);
 
+    //--------------------------------------------------------------------------
+    //! @brief      get cached UTOC chunk size for this device
+    //!
+    //! @param[in]  write  true -> write size; false -> read size
+    //!
+    //! @return     chunk size; 0 if not yet probed
+    //--------------------------------------------------------------------------
+    uint8_t utocChunkSize(bool write);
+
+    //--------------------------------------------------------------------------
+    //! @brief      cache probed UTOC chunk size for this device
+    //!
+    //! @param[in]  write  true -> write size; false -> read size
+    //! @param[in]  sz     The chunk size
+    //--------------------------------------------------------------------------
+    void setUTOCChunkSize(bool write, uint8_t sz);
+
     //--------------------------------------------------------------------------
     //! @brief      apply USB execution patch
     //!
@@ -268,12 +343,33 @@ class CNetMdPatch
     //--------------------------------------------------------------------------
     //! @brief      finalize TOC though exploit
     //!
-    //! @param[in]  reset  do device reset if true
+    //! @param[in]  reset     do device reset if true
+    //! @param[in]  progress  optional progress callback
     //!
     //! @return     NetMdErr
     //! @see        NetMdErr
     //--------------------------------------------------------------------------
-    int finalizeTOC(bool reset);
+    int finalizeTOC(bool reset, const ProgressCallback& progress = nullptr);
+
+    //--------------------------------------------------------------------------
+    //! @brief      wait for one finalize TOC step: poll the operating status
+    //!             until the device was busy and is ready again; if the
+    //!             status can't be read, wait until the deadline
+    //!
+    //! @param[in]  maxMs     deadline in milliseconds
+    //! @param[in]  from      progress at start
+    //! @param[in]  to        progress at end
+    //! @param[in]  progress  progress callback (may be empty)
+    //--------------------------------------------------------------------------
+    void waitTOCStep(int maxMs, int from, int to, const ProgressCallback& progress);
+
+    //--------------------------------------------------------------------------
+    //! @brief      report TOC progress (callback or log)
+    //!
+    //! @param[in]  progress  progress callback (may be empty)
+    //! @param[in]  percent   The progress in percent
+    //--------------------------------------------------------------------------
+    static void tocProgress(const ProgressCallback& progress, int percent);
 
     //--------------------------------------------------------------------------
     //! @brief      USB execution (run exploit)
@@ -323,6 +419,41 @@ class CNetMdPatch
     //--------------------------------------------------------------------------
     int patch(const PatchComplect& pc);
 
+    //--------------------------------------------------------------------------
+    //! @brief      is the USB execution patch installed?
+    //!             (checks patch storage only, no device access)
+    //!
+    //! @return     true if installed, false if not
+    //--------------------------------------------------------------------------
+    bool usbExecActive() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      program a patch slot through memory access, opening
+    //!             each memory region only once
+    //!
+    //! @param[in]  base     The patch slot base address
+    //! @param[in]  control  The main control address
+    //! @param[in]  addr     The patch address
+    //! @param[in]  data     The patch data
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int patchMem(uint32_t base, uint32_t control, uint32_t addr, const NetMDByteVector& data);
+
+    //--------------------------------------------------------------------------
+    //! @brief      program a patch slot with one USB execution payload
+    //!
+    //! @param[in]  base     The patch slot base address
+    //! @param[in]  control  The main control address
+    //! @param[in]  addr     The patch address
+    //! @param[in]  data     The patch data
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int patchExec(uint32_t base, uint32_t control, uint32_t addr, const NetMDByteVector& data);
+
     //--------------------------------------------------------------------------
     //! @brief      unpatch up to all installed patches
     //!
@@ -453,6 +584,38 @@ class CNetMdPatch
     //--------------------------------------------------------------------------
     void updatePatchStorage();
 
+    //--------------------------------------------------------------------------
+    //! @brief      take patch storage from device cache, if all patch slots
+    //!             on the device still match (one read)
+    //!
+    //! @return     true if patch storage was taken from cache
+    //--------------------------------------------------------------------------
+    bool patchStorageFromCache();
+
+    //--------------------------------------------------------------------------
+    //! @brief      read control, address and value of all patch slots at once
+    //!
+    //! @param[out] regs  The patch slot registers (0x10 bytes per slot)
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int readPatchSlots(NetMDByteVector& regs);
+
+    //--------------------------------------------------------------------------
+    //! @brief      rebuild patch storage from the patch slots on the device
+    //!             without writing known patches
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int discoverPatches();
+
+    //--------------------------------------------------------------------------
+    //! @brief      write patch storage to device cache
+    //--------------------------------------------------------------------------
+    void cachePatchStorage();
+
     CNetMdDev& mNetMd;
 
     //! @brief patch areas used
@@ -460,6 +623,9 @@ class CNetMdPatch
 
     /// is the patch store valid?
     bool mPatchStoreValid;
+
+    /// UTOC sectors as last read from / written to the device
+    UTOCImages mUTOCImages;
 };
 
 } // ~namespace
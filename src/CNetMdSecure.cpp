@@ -28,6 +28,7 @@
  */
 
 #include <gcrypt.h>
+#include <algorithm>
 #include <cmath>
 #include "CNetMdSecure.h"
 #include "CNetMdDev.hpp"
@@ -39,6 +40,7 @@
 #include <ios>
 #include <thread>
 #include <chrono>
+#include <new>
 
 namespace netmd {
 
@@ -50,6 +52,14 @@ void CNetMdSecure::deviceRemoved()
     mPatch.deviceRemoved();
 }
 
+//--------------------------------------------------------------------------
+//! @brief      forget known UTOC sector images
+//--------------------------------------------------------------------------
+void CNetMdSecure::dropUTOCImages()
+{
+    mPatch.dropUTOCImages();
+}
+
 //--------------------------------------------------------------------------
 //! @brief      get payload position in response
 //!
@@ -1226,6 +1236,56 @@ int CNetMdSecure::setTrackProtection(uint8_t val)
 //! @see        NetMdErr
 //--------------------------------------------------------------------------
 int CNetMdSecure::sendAudioTrack(const std::string& filename, const std::string& title, DiskFormat otf)
+{
+    mFLOW(DEBUG);
+    uint16_t trackNo = 0;
+
+    std::ifstream audioFile(filename, std::ios_base::in | std::ios_base::binary);
+    if (!audioFile)
+    {
+        mLOG(CRITICAL) << "Can't open audio file : " << filename;
+        return NETMDERR_PARAM;
+    }
+
+    // get pointer to associated buffer object
+    std::filebuf* pbuf = audioFile.rdbuf();
+
+    // get file size using buffer's members
+    size_t data_size = pbuf->pubseekoff (0, audioFile.end, audioFile.in);
+    pbuf->pubseekpos(0, audioFile.in);
+
+    // allocate memory to contain file data plus some buffer for e.g. padding
+    uint8_t* data = new (std::nothrow) uint8_t[data_size + 2048];
+
+    if (data == nullptr)
+    {
+        mLOG(CRITICAL) << "error allocating memory for file input";
+        return NETMDERR_OTHER;
+    }
+
+    // read source
+    pbuf->sgetn(reinterpret_cast<char*>(data), data_size);
+
+    audioFile.close();
+
+    return sendAudioData(data, data_size, title, otf, trackNo);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      Sends audio data as one track
+//!
+//! @param[in]  data       The audio file content; allocated with new[] and
+//!                        2048 spare bytes. Will be deleted here.
+//! @param[in]  data_size  The data size
+//! @param[in]  title      The title
+//! @param[in]  otf        The disk format
+//! @param[out] trackNo    The number of the new track
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdSecure::sendAudioData(uint8_t* data, size_t data_size, const std::string& title,
+                                DiskFormat otf, uint16_t& trackNo)
 {
     mFLOW(DEBUG);
     int ret = NETMDERR_NO_ERROR;
@@ -1262,7 +1322,7 @@ int CNetMdSecure::sendAudioTrack(const std::string& filename, const std::string&
     uint8_t hostnonce[8] = {0,};
     uint8_t devnonce[8] = {0,};
     uint8_t sessionkey[8] = {0,};
-    uint16_t trackNo = 0;
+    trackNo = 0;
 
     uint8_t kek[] =
     {
@@ -1281,8 +1341,6 @@ int CNetMdSecure::sendAudioTrack(const std::string& filename, const std::string&
     TrackPackets *packets = nullptr;
     uint32_t packet_count = 0;
     uint32_t packet_length = 0;
-    uint8_t *data = nullptr;
-    size_t data_size = 0;
 
     uint8_t uuid[8] = {0,};
     uint8_t new_contentid[20] = {0,};
@@ -1298,32 +1356,6 @@ int CNetMdSecure::sendAudioTrack(const std::string& filename, const std::string&
 
     try
     {
-        std::ifstream audioFile(filename, std::ios_base::in | std::ios_base::binary);
-        if (!audioFile)
-        {
-            mNetMdThrow(NETMDERR_PARAM, "Can't open audio file : " << filename);
-        }
-
-        // get pointer to associated buffer object
-        std::filebuf* pbuf = audioFile.rdbuf();
-
-        // get file size using buffer's members
-        data_size = pbuf->pubseekoff (0, audioFile.end, audioFile.in);
-        pbuf->pubseekpos(0, audioFile.in);
-
-        // allocate memory to contain file data plus some buffer for e.g. padding
-        data = new uint8_t[data_size + 2048];
-
-        if (data == nullptr)
-        {
-            mNetMdThrow(NETMDERR_OTHER, "error allocating memory for file input");
-        }
-
-        // read source
-        pbuf->sgetn(reinterpret_cast<char*>(data), data_size);
-
-        audioFile.close();
-
         if (data_size < MIN_WAV_LENGTH)
         {
             mNetMdThrow(NETMDERR_NOT_SUPPORTED, "audio file too small (corrupt or not supported)");
@@ -1589,6 +1621,136 @@ int CNetMdSecure::sendAudioTrack(const std::string& filename, const std::string&
     return ret;
 }
 
+//--------------------------------------------------------------------------
+//! @brief      concatenate PCM WAVE files into one WAVE image
+//!
+//! All files must share the same format (44.1kHz / 16 bit, same
+//! channel count).
+//!
+//! @param[in]  files    The WAVE files
+//! @param[out] data     The WAVE image; allocated with new[] and 2048 spare
+//!                      bytes as needed by @ref sendAudioData
+//! @param[out] dataSz   The image size
+//! @param[out] samples  The sample count (per channel) of every file
+//!
+//! @return     NetMdErr
+//! @see        NetMdErr
+//--------------------------------------------------------------------------
+int CNetMdSecure::joinWaveFiles(const std::vector<std::string>& files, uint8_t** data,
+                                size_t& dataSz, std::vector<uint64_t>& samples)
+{
+    mFLOW(DEBUG);
+
+    // position and size of PCM data in source file
+    struct Source
+    {
+        size_t mPos;
+        size_t mSize;
+    };
+
+    std::vector<Source> sources;
+    NetMDByteVector     hdr(65'536);
+    uint16_t            channels = 0;
+    size_t              pcmSz    = 0;
+
+    *data  = nullptr;
+    dataSz = 0;
+    samples.clear();
+
+    for (const auto& f : files)
+    {
+        std::ifstream wave(f, std::ios_base::in | std::ios_base::binary);
+        wave.read(reinterpret_cast<char*>(hdr.data()), hdr.size());
+
+        size_t      got = static_cast<size_t>(wave.gcount());
+        WireFormat  wf;
+        DiskFormat  df;
+        AudioPatch  patch;
+        uint8_t     ch;
+        uint32_t    hdrSz;
+        size_t      pos = 0;
+
+        if ((got < MIN_WAV_LENGTH) || !audioSupported(hdr.data(), got, wf, df, patch, ch, hdrSz)
+            || (wf != NETMD_WIREFORMAT_PCM) || ((pos = waveDataPosition(hdr.data(), hdrSz, got)) == 0))
+        {
+            mLOG(CRITICAL) << "Album file " << f << " isn't a supported PCM WAVE file!";
+            return NETMDERR_NOT_SUPPORTED;
+        }
+
+        uint16_t nch = fromLittleEndianArray<uint16_t>(hdr.data() + 22);
+
+        if (channels && (channels != nch))
+        {
+            mLOG(CRITICAL) << "Album file " << f << " has a different channel count!";
+            return NETMDERR_NOT_SUPPORTED;
+        }
+        channels = nch;
+
+        // don't trust the data chunk size blindly
+        wave.clear();
+        wave.seekg(0, wave.end);
+        size_t fileSz = static_cast<size_t>(wave.tellg());
+        size_t sz     = std::min<size_t>(fromLittleEndianArray<uint32_t>(hdr.data() + pos + 4),
+                                         fileSz - (pos + 8));
+
+        // whole samples only
+        sz -= sz % (2 * nch);
+
+        sources.push_back({pos + 8, sz});
+        samples.push_back(sz / (2 * nch));
+        pcmSz += sz;
+    }
+
+    if (sources.empty())
+    {
+        return NETMDERR_PARAM;
+    }
+
+    NetMDByteVector wavHdr;
+    addArrayData(wavHdr, reinterpret_cast<const uint8_t*>("RIFF"), 4);
+    wavHdr += toLittleEndianByteVector(static_cast<uint32_t>(36 + pcmSz));
+    addArrayData(wavHdr, reinterpret_cast<const uint8_t*>("WAVEfmt "), 8);
+    wavHdr += toLittleEndianByteVector(static_cast<uint32_t>(16));
+    wavHdr += toLittleEndianByteVector(static_cast<uint16_t>(1));
+    wavHdr += toLittleEndianByteVector(channels);
+    wavHdr += toLittleEndianByteVector(static_cast<uint32_t>(44'100));
+    wavHdr += toLittleEndianByteVector(static_cast<uint32_t>(44'100 * 2 * channels));
+    wavHdr += toLittleEndianByteVector(static_cast<uint16_t>(2 * channels));
+    wavHdr += toLittleEndianByteVector(static_cast<uint16_t>(16));
+    addArrayData(wavHdr, reinterpret_cast<const uint8_t*>("data"), 4);
+    wavHdr += toLittleEndianByteVector(static_cast<uint32_t>(pcmSz));
+
+    uint8_t* pData = new (std::nothrow) uint8_t[wavHdr.size() + pcmSz + 2048];
+
+    if (pData == nullptr)
+    {
+        mLOG(CRITICAL) << "error allocating memory for album data";
+        return NETMDERR_OTHER;
+    }
+
+    memcpy(pData, wavHdr.data(), wavHdr.size());
+    dataSz = wavHdr.size();
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        std::ifstream wave(files.at(i), std::ios_base::in | std::ios_base::binary);
+        wave.seekg(sources.at(i).mPos);
+        wave.read(reinterpret_cast<char*>(pData + dataSz), sources.at(i).mSize);
+
+        if (static_cast<size_t>(wave.gcount()) != sources.at(i).mSize)
+        {
+            mLOG(CRITICAL) << "Can't read album file " << files.at(i);
+            delete [] pData;
+            dataSz = 0;
+            return NETMDERR_OTHER;
+        }
+        dataSz += sources.at(i).mSize;
+    }
+
+    *data = pData;
+    return NETMDERR_NO_ERROR;
+}
+
 //--------------------------------------------------------------------------
 //! @brief      is SP upload supported?
 //!
@@ -1623,11 +1785,6 @@ int CNetMdSecure::setInitTrackTitle(uint16_t trackNo, const std::string& title)
     mFLOW(DEBUG);
     int ret = 1;
 
-    // handshakes for 780/980/etc
-    uint8_t cache[] = {0x00, 0x18, 0x08, 0x10, 0x18, 0x02, 0x03, 0x00};
-    uint8_t sync[]  = {0x00, 0x18, 0x08, 0x10, 0x18, 0x02, 0x00, 0x00};
-
-
     NetMDByteVector ba;
     NetMDResp query;
     addArrayData(ba, reinterpret_cast<const uint8_t*>(title.c_str()), title.size());
@@ -1642,7 +1799,9 @@ int CNetMdSecure::setInitTrackTitle(uint16_t trackNo, const std::string& title)
 
     if (((ret = formatQuery(format, params, query)) > 0) && (query != nullptr))
     {
-        mNetMd.exchange(cache, sizeof(cache));
+        // handshakes for 780/980/etc
+        std::unique_lock<std::recursive_mutex> lck(mNetMd.mMtxDevAcc);
+        mNetMd.changeDscrtState(CNetMdDev::Descriptor::audioUTOC1TD, CNetMdDev::DscrtAction::openwrite);
         if (mNetMd.exchange(query.get(), ret) > 0)
         {
             ret = NETMDERR_NO_ERROR;
@@ -1652,7 +1811,7 @@ int CNetMdSecure::setInitTrackTitle(uint16_t trackNo, const std::string& title)
             ret = NETMDERR_PARAM;
             mLOG(CRITICAL) << "exchange() failed.";
         }
-        mNetMd.exchange(sync, sizeof(sync));
+        mNetMd.changeDscrtState(CNetMdDev::Descriptor::audioUTOC1TD, CNetMdDev::DscrtAction::close);
     }
     else
     {
@@ -1702,14 +1861,15 @@ int CNetMdSecure::writeUTOCSector(UTOCSector s, const NetMDByteVector& data)
 //--------------------------------------------------------------------------
 //! @brief      finalize TOC though exploit
 //!
-//! @param[in]  reset  do device reset if true
+//! @param[in]  reset     do device reset if true
+//! @param[in]  progress  optional progress callback
 //!
 //! @return     NetMdErr
 //! @see        NetMdErr
 //--------------------------------------------------------------------------
-int CNetMdSecure::finalizeTOC(bool reset)
+int CNetMdSecure::finalizeTOC(bool reset, const ProgressCallback& progress)
 {
-    return mPatch.finalizeTOC(reset);
+    return mPatch.finalizeTOC(reset, progress);
 }
 
 //--------------------------------------------------------------------------
@@ -130,6 +130,11 @@ class CNetMdSecure
     //--------------------------------------------------------------------------
     void deviceRemoved();
 
+    //--------------------------------------------------------------------------
+    //! @brief      forget known UTOC sector images
+    //--------------------------------------------------------------------------
+    void dropUTOCImages();
+
     //--------------------------------------------------------------------------
     //! @brief      get payload position in response
     //!
@@ -403,6 +408,40 @@ class CNetMdSecure
     int sendAudioTrack(const std::string& filename, const std::string& title,
                        DiskFormat otf);
 
+    //--------------------------------------------------------------------------
+    //! @brief      Sends audio data as one track
+    //!
+    //! @param[in]  data       The audio file content; allocated with new[] and
+    //!                        2048 spare bytes. Will be deleted here.
+    //! @param[in]  data_size  The data size
+    //! @param[in]  title      The title
+    //! @param[in]  otf        The disk format
+    //! @param[out] trackNo    The number of the new track
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    int sendAudioData(uint8_t* data, size_t data_size, const std::string& title,
+                      DiskFormat otf, uint16_t& trackNo);
+
+    //--------------------------------------------------------------------------
+    //! @brief      concatenate PCM WAVE files into one WAVE image
+    //!
+    //! All files must share the same format (44.1kHz / 16 bit, same
+    //! channel count).
+    //!
+    //! @param[in]  files    The WAVE files
+    //! @param[out] data     The WAVE image; allocated with new[] and 2048 spare
+    //!                      bytes as needed by @ref sendAudioData
+    //! @param[out] dataSz   The image size
+    //! @param[out] samples  The sample count (per channel) of every file
+    //!
+    //! @return     NetMdErr
+    //! @see        NetMdErr
+    //--------------------------------------------------------------------------
+    static int joinWaveFiles(const std::vector<std::string>& files, uint8_t** data,
+                             size_t& dataSz, std::vector<uint64_t>& samples);
+
     //--------------------------------------------------------------------------
     //! @brief      is SP upload supported?
     //!
@@ -485,12 +524,13 @@ class CNetMdSecure
     //--------------------------------------------------------------------------
     //! @brief      finalize TOC though exploit
     //!
-    //! @param[in]  reset  do device reset if true
+    //! @param[in]  reset     do device reset if true
+    //! @param[in]  progress  optional progress callback
     //!
     //! @return     NetMdErr
     //! @see        NetMdErr
     //--------------------------------------------------------------------------
-    int finalizeTOC(bool reset);
+    int finalizeTOC(bool reset, const ProgressCallback& progress = nullptr);
 
     //--------------------------------------------------------------------------
     //! @brief      is PCM speedup supportd
@@ -34,6 +34,7 @@
 #include "CNetMdTOC.h"
 #include "log.h"
 #include "md_toc.h"
+#include "md_toc_utils.h"
 #include "netmd_utils.h"
 
 namespace netmd {
@@ -46,7 +47,8 @@ namespace netmd {
 //! @param[in/out] data        The TOC data
 //--------------------------------------------------------------------------
 CNetMdTOC::CNetMdTOC(int trackCount, uint32_t lenInMs, uint8_t* data)
-    :mpToc(nullptr), mCurPos(0), mDAOTrack(0), mDAOGroups(0)
+    :mpToc(nullptr), mCurPos(0), mDAOTrack(0), mDAOGroups(0),
+     mUsedCells{0,}, mUsedFrags{0,}
 {
     import(trackCount, lenInMs, data);
 }
@@ -97,6 +99,8 @@ void CNetMdTOC::import(int trackCount, uint32_t lenInMs, uint8_t* data)
 
         // get whole groups count
         mDAOGroups = daoGroupCount();
+
+        buildSlotMaps();
     }
 }
 
@@ -126,7 +130,13 @@ int CNetMdTOC::addTrack(uint8_t no, uint32_t lengthMs, const std::string& title,
 
     if (no == 1)
     {
-        // free used DAO track fragment in TOC
+        // free used DAO track fragments in TOC
+        uint8_t link = mpToc->mTracks.trackmap[mDAOTrack];
+        while (link && toc::slotUsed(mUsedFrags, link))
+        {
+            toc::markSlot(mUsedFrags, link, false);
+            link = mpToc->mTracks.fraglist[link].link;
+        }
         mpToc->mTracks.trackmap[mDAOTrack] = 0;
     }
 
@@ -139,8 +149,11 @@ int CNetMdTOC::addTrack(uint8_t no, uint32_t lengthMs, const std::string& title,
     // Splitting can be done on each sound group.
     // Most important is the addressing scheme.
 
+    // slot maps are maintained on allocation, nothing to rebuild here
     mpToc->mTracks.ntracks = currTrack;
+
     mpToc->mTracks.trackmap[currTrack] = fragNo;
+    toc::markSlot(mUsedFrags, fragNo, true);
 
     DAOFragments trFrags = getTrackFragments(no, trackGroups);
 
@@ -154,6 +167,7 @@ int CNetMdTOC::addTrack(uint8_t no, uint32_t lengthMs, const std::string& title,
         fragment.mode  = mono ? toc::MONO_TRACK_MODE : toc::DEF_TRACK_MODE;
         fragNo         = (it == (trFrags.end() - 1)) ? 0 : nextFreeTrackFragment();
         fragment.link  = fragNo;
+        toc::markSlot(mUsedFrags, fragNo, true);
     }
 
     setTrackTitle(currTrack, title);
@@ -179,6 +193,24 @@ int CNetMdTOC::setTrackTitle(uint8_t no, const std::string& title)
         return -1;
     }
 
+    if ((no == mDAOTrack) || (no == 0))
+    {
+        // release the old title chain; new tracks don't have one yet
+        uint8_t link = mpToc->mTitles.titlemap[no];
+
+        // disc title starts in cell 0, which is never free
+        if ((no == 0) && (link == 0))
+        {
+            link = mpToc->mTitles.titlelist[0].link;
+        }
+
+        while (link && toc::slotUsed(mUsedCells, link))
+        {
+            toc::markSlot(mUsedCells, link, false);
+            link = mpToc->mTitles.titlelist[link].link;
+        }
+    }
+
     if (no == mDAOTrack)
     {
         mpToc->mTitles.titlemap[no] = 0;
@@ -190,6 +222,7 @@ int CNetMdTOC::setTrackTitle(uint8_t no, const std::string& title)
     }
 
     mpToc->mTitles.titlemap[no] = mpToc->mTitles.free_title_slot;
+    toc::markSlot(mUsedCells, mpToc->mTitles.free_title_slot, true);
 
     for(size_t sz = 0; sz < title.size(); sz += 7)
     {
@@ -207,6 +240,7 @@ int CNetMdTOC::setTrackTitle(uint8_t no, const std::string& title)
         if ((title.size() - (sz + toCpy)) > 0)
         {
             cell.link = mpToc->mTitles.free_title_slot;
+            toc::markSlot(mUsedCells, cell.link, true);
         }
     }
     return 0;
@@ -226,18 +260,10 @@ int CNetMdTOC::setTrackTStamp(int no, const std::time_t& tstamp)
 
     auto* tm = gmtime(&tstamp);
 
-#define mDecToHexDate(x__) (((x__ / 10) << 4) | ((x__ % 10) & 0xf))
-
-    mpToc->mTimes.timelist[no].d  = mDecToHexDate(tm->tm_mday);         // 1 ... 31
-    mpToc->mTimes.timelist[no].mo = mDecToHexDate((tm->tm_mon + 1));    // 0 ... 11
-    mpToc->mTimes.timelist[no].y  = mDecToHexDate((tm->tm_year % 100)); // since 1900
-    mpToc->mTimes.timelist[no].h  = mDecToHexDate(tm->tm_hour);         // 0 ... 23
-    mpToc->mTimes.timelist[no].m  = mDecToHexDate(tm->tm_min);          // 0 ... 59
-    mpToc->mTimes.timelist[no].s  = mDecToHexDate(tm->tm_sec);          // 0 ... 59
+    toc::setTimestamp(mpToc->mTimes.timelist[no], *tm);
     mpToc->mTimes.timelist[no].signature = toBigEndian(toc::SIGNATURE);
 
     mpToc->mTimes.free_time_slot = no + 1;
-#undef mDecToHexDate
     return 0;
 }
 
@@ -290,6 +316,13 @@ std::string CNetMdTOC::trackTitle(int trackNo) const
     if (mpToc)
     {
         int cell = mpToc->mTitles.titlemap[trackNo];
+
+        // untitled track
+        if ((cell == 0) && (trackNo != 0))
+        {
+            return s;
+        }
+
         do
         {
             for (int i = 0; i < 7; i++)
@@ -371,41 +404,99 @@ std::string CNetMdTOC::discInfo() const
 }
 
 //--------------------------------------------------------------------------
-//! @brief      get next free title cell
+//! @brief      get sound group count of a track
 //!
-//! @return     cell number or -1 on error
+//! @param[in]  trackNo  The track number
+//!
+//! @return     sound groups
 //--------------------------------------------------------------------------
-int CNetMdTOC::nextFreeTitleCell()
+uint32_t CNetMdTOC::trackGroups(int trackNo) const
 {
-    if (!mpToc)
+    uint32_t ret = 0;
+
+    if (mpToc && (trackNo > 0) && (trackNo <= mpToc->mTracks.ntracks))
     {
-        return -1;
+        uint8_t fragment = mpToc->mTracks.trackmap[trackNo];
+
+        while (fragment != 0)
+        {
+            const toc::fragment& f = mpToc->mTracks.fraglist[fragment];
+            ret     += (CSG::fromCsg(f.end) - CSG::fromCsg(f.start)) + 1;
+            fragment = f.link;
+        }
     }
 
-    std::vector<uint8_t> used;
+    return ret;
+}
 
-    for (int i = 0; i <= mpToc->mTracks.ntracks; i++)
+//--------------------------------------------------------------------------
+//! @brief      get exact track length computed from sound groups
+//!
+//! @param[in]  trackNo  The track number
+//!
+//! @return     length in milliseconds
+//--------------------------------------------------------------------------
+uint32_t CNetMdTOC::trackLength(int trackNo) const
+{
+    return CSG::toMs(trackGroups(trackNo), trackMode(trackNo));
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get track mode (see mode flags in md_toc.h)
+//!
+//! @param[in]  trackNo  The track number
+//!
+//! @return     mode of first track fragment
+//--------------------------------------------------------------------------
+uint8_t CNetMdTOC::trackMode(int trackNo) const
+{
+    if (mpToc && (trackNo > 0) && (trackNo <= mpToc->mTracks.ntracks))
     {
-        uint8_t link = mpToc->mTitles.titlemap[i];
+        return mpToc->mTracks.fraglist[mpToc->mTracks.trackmap[trackNo]].mode;
+    }
 
-        do
-        {
-            used.push_back(link);
-            link = mpToc->mTitles.titlelist[link].link;
-        }
-        while(link);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get track time stamp
+//!
+//! @param[in]  trackNo  The track number
+//!
+//! @return     recording time (UTC) or 0 if not set
+//--------------------------------------------------------------------------
+std::time_t CNetMdTOC::trackTStamp(int trackNo) const
+{
+    if (!mpToc || (trackNo < 0) || (trackNo > 255))
+    {
+        return 0;
     }
 
-    // cell 0 is never free
-    for (int i = 1; i <= 255; i++)
+    uint8_t slot = mpToc->mTimes.timemap[trackNo];
+
+    if ((slot == 0) && (trackNo != 0))
     {
-        if (std::find(used.begin(), used.end(), i) == used.end())
-        {
-            return i;
-        }
+        return 0;
     }
 
-    return -1;
+    const toc::timestamp& ts = mpToc->mTimes.timelist[slot];
+
+    return toc::timestampToTime(ts);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get next free title cell
+//!
+//! @return     cell number or -1 on error
+//--------------------------------------------------------------------------
+int CNetMdTOC::nextFreeTitleCell()
+{
+    if (!mpToc)
+    {
+        return -1;
+    }
+
+    return toc::firstFreeSlot(mUsedCells);
 }
 
 //--------------------------------------------------------------------------
@@ -420,30 +511,51 @@ int CNetMdTOC::nextFreeTrackFragment()
         return -1;
     }
 
-    std::vector<uint8_t> used;
+    return toc::firstFreeSlot(mUsedFrags);
+}
 
-    for (int i = 0; i <= mpToc->mTracks.ntracks; i++)
+//--------------------------------------------------------------------------
+//! @brief      build title cell and track fragment occupancy maps
+//!             by walking all link chains (on import only; later
+//!             changes update the maps directly)
+//--------------------------------------------------------------------------
+void CNetMdTOC::buildSlotMaps()
+{
+    memset(mUsedCells, 0, sizeof(mUsedCells));
+    memset(mUsedFrags, 0, sizeof(mUsedFrags));
+
+    // slot 0 is never free
+    toc::markSlot(mUsedCells, 0, true);
+    toc::markSlot(mUsedFrags, 0, true);
+
+    if (!mpToc)
     {
-        uint8_t link = mpToc->mTracks.trackmap[i];
+        return;
+    }
 
+    // entry 0 of track map is the free list, so it's included here
+    for (int i = 0; i <= mpToc->mTracks.ntracks; i++)
+    {
+        // Slot 0 is a valid chain start (e.g. disc title). Other than
+        // that, a set bit ends the walk: the rest is already marked.
+        uint8_t link = mpToc->mTitles.titlemap[i];
         do
         {
-            used.push_back(link);
-            link = mpToc->mTracks.fraglist[link].link;
+            if (link && toc::slotUsed(mUsedCells, link)) break;
+            toc::markSlot(mUsedCells, link, true);
+            link = mpToc->mTitles.titlelist[link].link;
         }
-        while(link);
-    }
+        while (link);
 
-    // fragment zero is never used
-    for (int i = 1; i <= 255; i++)
-    {
-        if (std::find(used.begin(), used.end(), i) == used.end())
+        link = mpToc->mTracks.trackmap[i];
+        do
         {
-            return i;
+            if (link && toc::slotUsed(mUsedFrags, link)) break;
+            toc::markSlot(mUsedFrags, link, true);
+            link = mpToc->mTracks.fraglist[link].link;
         }
+        while (link);
     }
-
-    return -1;
 }
 
 //--------------------------------------------------------------------------
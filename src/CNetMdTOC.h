@@ -49,6 +49,7 @@ We virtualy split the tracks and give them titles.
 #include <vector>
 #include <ctime>
 #include "md_toc.h"
+#include "md_toc_utils.h"
 
 namespace netmd {
 
@@ -161,6 +162,42 @@ public:
     //--------------------------------------------------------------------------
     std::string discInfo() const;
 
+    //--------------------------------------------------------------------------
+    //! @brief      get sound group count of a track
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     sound groups
+    //--------------------------------------------------------------------------
+    uint32_t trackGroups(int trackNo) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get exact track length computed from sound groups
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     length in milliseconds
+    //--------------------------------------------------------------------------
+    uint32_t trackLength(int trackNo) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track mode (see mode flags in md_toc.h)
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     mode of first track fragment
+    //--------------------------------------------------------------------------
+    uint8_t trackMode(int trackNo) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track time stamp
+    //!
+    //! @param[in]  trackNo  The track number
+    //!
+    //! @return     recording time (UTC) or 0 if not set
+    //--------------------------------------------------------------------------
+    std::time_t trackTStamp(int trackNo) const;
+
 protected:
 
     //--------------------------------------------------------------------------
@@ -197,6 +234,13 @@ protected:
     //--------------------------------------------------------------------------
     int nextFreeTrackFragment();
 
+    //--------------------------------------------------------------------------
+    //! @brief      build title cell and track fragment occupancy maps
+    //!             by walking all link chains (on import only; later
+    //!             changes update the maps directly)
+    //--------------------------------------------------------------------------
+    void buildSlotMaps();
+
     //--------------------------------------------------------------------------
     //! @brief      get group count of DAO track
     //!
@@ -235,6 +279,12 @@ private:
 
     /// the fragments used for DAO track
     DAOFragments mDAOFragments;
+
+    /// occupied title cells (bit n -> cell n)
+    toc::SlotMap mUsedCells;
+
+    /// occupied track fragments (bit n -> fragment n)
+    toc::SlotMap mUsedFrags;
 };
 
 //------------------------------------------------------------------------------
@@ -359,6 +409,53 @@ public:
         return oss.str();
     }
 
+    //--------------------------------------------------------------------------
+    //! @brief      samples (per channel, 44.1kHz) held by one sound group
+    //!
+    //! A sound group holds 512 samples per channel in SP stereo, twice as
+    //! many in SP mono and LP2, four times as many in LP4.
+    //!
+    //! @param[in]  mode  The track mode (see md_toc.h)
+    //!
+    //! @return     samples per sound group
+    //--------------------------------------------------------------------------
+    static uint32_t groupSamples(uint8_t mode)
+    {
+        uint32_t samples = 512;
+
+        if (mode & toc::F_SP_MODE)
+        {
+            if (!(mode & toc::F_STEREO))
+            {
+                samples *= 2;   // SP mono
+            }
+        }
+        else if (mode & toc::F_STEREO)
+        {
+            samples *= 2;       // LP2
+        }
+        else
+        {
+            samples *= 4;       // LP4
+        }
+
+        return samples;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      convert group count into exact time
+    //!
+    //! @param[in]  groupCount  The group count
+    //! @param[in]  mode        The track mode (see md_toc.h)
+    //!
+    //! @return     time in milliseconds
+    //--------------------------------------------------------------------------
+    static uint32_t toMs(uint32_t groupCount, uint8_t mode)
+    {
+        uint64_t samples = groupSamples(mode);
+        return static_cast<uint32_t>((groupCount * samples * 1'000 + 22'050) / 44'100);
+    }
+
     //--------------------------------------------------------------------------
     //! @brief      get next disc address
     //!
@@ -0,0 +1,248 @@
+/*
+ * CNetMdTrace.cpp
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include "CNetMdTrace.h"
+
+namespace netmd {
+
+namespace {
+
+/// names of traced functions (see CNetMdTrace::Kind)
+const char* const KIND_NAMES[] = {
+    "exchange",
+    "sendCmd",
+    "getResponse",
+    "responseLength",
+    "bulkTransfer"
+};
+
+//--------------------------------------------------------------------------
+//! @brief      nano seconds between two time points
+//--------------------------------------------------------------------------
+uint64_t nsSince(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write ns value as us with 3 decimals (Chrome trace unit)
+//--------------------------------------------------------------------------
+std::ostream& usFromNs(std::ostream& os, uint64_t ns)
+{
+    char fill = os.fill('0');
+    os << (ns / 1000) << '.' << std::setw(3) << (ns % 1000);
+    os.fill(fill);
+    return os;
+}
+
+} // ~namespace
+
+//--------------------------------------------------------------------------
+//! @brief      Constructs a new instance.
+//!
+//! @param      trc     The trace
+//! @param[in]  kind    The kind
+//! @param[in]  cmd     The command (optional)
+//! @param[in]  cmdLen  The command length
+//--------------------------------------------------------------------------
+CNetMdTrace::Scope::Scope(CNetMdTrace& trc, Kind kind, const uint8_t* cmd, size_t cmdLen)
+    : mTrc(trc), mpParent(nullptr), mEvt{}, mActive(trc.enabled())
+{
+    if (mActive)
+    {
+        mEvt.mKind  = kind;
+        mEvt.mReqSz = static_cast<uint32_t>(cmdLen);
+
+        if (cmd != nullptr)
+        {
+            std::memcpy(mEvt.mOpc, cmd, std::min(cmdLen, OPC_BYTES));
+        }
+
+        mpParent   = mTrc.mpTop;
+        mTrc.mpTop = this;
+        mStart     = std::chrono::steady_clock::now();
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      Destroys the object; records the event.
+//--------------------------------------------------------------------------
+CNetMdTrace::Scope::~Scope()
+{
+    if (mActive)
+    {
+        auto now       = std::chrono::steady_clock::now();
+        mEvt.mStartNs  = nsSince(mTrc.mT0, mStart);
+        mEvt.mDurNs    = nsSince(mStart, now);
+
+        if (mEvt.mKind == TRC_RESPONSE_LENGTH)
+        {
+            mEvt.mPolls++;
+        }
+
+        // enclosing scopes sum up polls and sleep time
+        if (mpParent != nullptr)
+        {
+            mpParent->mEvt.mPolls      += mEvt.mPolls;
+            mpParent->mEvt.mSleepNs    += mEvt.mSleepNs;
+            mpParent->mEvt.mSleepReqUs += mEvt.mSleepReqUs;
+        }
+
+        mTrc.mpTop = mpParent;
+
+        // trace might have been re-enabled in between
+        if (mTrc.enabled())
+        {
+            mTrc.record(mEvt);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      store result
+//!
+//! @param[in]  ret     The response size or NetMdErr
+//! @param[in]  status  The NetMD status (optional)
+//!
+//! @return     ret
+//--------------------------------------------------------------------------
+int CNetMdTrace::Scope::done(int ret, uint8_t status)
+{
+    mEvt.mResult = ret;
+    mEvt.mStatus = status;
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      Constructs a new instance (disabled).
+//--------------------------------------------------------------------------
+CNetMdTrace::CNetMdTrace()
+    : mNext(0), mCount(0), mpTop(nullptr), mT0(std::chrono::steady_clock::now())
+{
+}
+
+//--------------------------------------------------------------------------
+//! @brief      enable / disable trace; drops recorded events
+//!
+//! @param[in]  events  The ring size in events (0 -> disable)
+//--------------------------------------------------------------------------
+void CNetMdTrace::enable(size_t events)
+{
+    std::vector<Event>(events).swap(mRing);
+    mNext  = 0;
+    mCount = 0;
+    mT0    = std::chrono::steady_clock::now();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      is trace enabled?
+//!
+//! @return     true if so
+//--------------------------------------------------------------------------
+bool CNetMdTrace::enabled() const
+{
+    return !mRing.empty();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      add sleep time to the current scope
+//!
+//! @param[in]  reqUs  The requested sleep time in us
+//! @param[in]  real   The real sleep time
+//--------------------------------------------------------------------------
+void CNetMdTrace::slept(uint32_t reqUs, std::chrono::nanoseconds real)
+{
+    if (mpTop != nullptr)
+    {
+        mpTop->mEvt.mSleepReqUs += reqUs;
+        mpTop->mEvt.mSleepNs    += static_cast<uint64_t>(real.count());
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      put event into ring
+//!
+//! @param[in]  evt   The event
+//--------------------------------------------------------------------------
+void CNetMdTrace::record(const Event& evt)
+{
+    mRing[mNext] = evt;
+    mNext        = (mNext + 1) % mRing.size();
+    mCount       = std::min(mCount + 1, mRing.size());
+}
+
+//--------------------------------------------------------------------------
+//! @brief      export recorded events as Chrome trace JSON
+//!
+//! @param      os    The stream to write to
+//!
+//! @return     number of exported events
+//--------------------------------------------------------------------------
+size_t CNetMdTrace::exportJson(std::ostream& os) const
+{
+    size_t first = (mCount < mRing.size()) ? 0 : mNext;
+    char   fill  = os.fill();
+
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (size_t i = 0; i < mCount; i++)
+    {
+        const Event& e = mRing.at((first + i) % mRing.size());
+
+        os << (i ? ",\n" : "\n") << "{\"name\":\"" << KIND_NAMES[e.mKind];
+
+        if (e.mReqSz && (e.mKind != TRC_BULK_TRANSFER))
+        {
+            os << std::hex;
+            for (size_t j = 0; j < std::min<size_t>(e.mReqSz, OPC_BYTES); j++)
+            {
+                os << ' ' << std::setw(2) << std::setfill('0') << static_cast<int>(e.mOpc[j]);
+            }
+            os << std::dec;
+        }
+
+        os << "\",\"cat\":\"usb\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":";
+        usFromNs(os, e.mStartNs) << ",\"dur\":";
+        usFromNs(os, e.mDurNs) << ",\"args\":{\"req\":" << e.mReqSz
+           << ",\"result\":" << e.mResult
+           << ",\"polls\":" << e.mPolls
+           << ",\"sleep_us\":";
+        usFromNs(os, e.mSleepNs) << ",\"sleep_req_us\":" << e.mSleepReqUs
+           << ",\"status\":\"0x" << std::hex << std::setw(2) << std::setfill('0')
+           << static_cast<int>(e.mStatus) << std::dec << "\"}}";
+    }
+
+    os << "\n]}\n";
+    os.fill(fill);
+    return mCount;
+}
+
+} // ~namespace
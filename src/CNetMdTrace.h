@@ -0,0 +1,199 @@
+/*
+ * CNetMdTrace.h
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/**
+@file CNetMdTrace.h
+
+# USB trace
+Records every USB exchange with the NetMD device as a small binary event
+in a preallocated ring (the oldest events get overwritten). Events nest:
+an @c exchange contains @c sendCmd and @c getResponse, which contain the
+@c responseLength polls. Each event holds the first command bytes, request
+and response size, the number of response length polls, the time spent
+sleeping between polls and the final NetMD status.
+
+The ring can be exported as Chrome trace JSON, which can be opened in
+@c chrome://tracing or https://ui.perfetto.dev .
+
+The trace isn't thread safe on its own. It belongs to one device and is
+only used with the device mutex held.
+*/
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace netmd {
+
+//------------------------------------------------------------------------------
+//! @brief      This class describes a binary USB trace ring.
+//------------------------------------------------------------------------------
+class CNetMdTrace
+{
+public:
+    /// traced functions
+    enum Kind : uint8_t
+    {
+        TRC_EXCHANGE,           ///< CNetMdDev::exchange
+        TRC_SEND_CMD,           ///< CNetMdDev::sendCmd
+        TRC_GET_RESPONSE,       ///< CNetMdDev::getResponse
+        TRC_RESPONSE_LENGTH,    ///< CNetMdDev::responseLength
+        TRC_BULK_TRANSFER       ///< CNetMdDev::bulkTransfer
+    };
+
+    /// number of command bytes stored per event
+    static constexpr size_t OPC_BYTES = 8;
+
+    /// one trace event (48 bytes)
+    struct Event
+    {
+        uint64_t mStartNs;          ///< start time since trace start
+        uint64_t mDurNs;            ///< duration
+        uint64_t mSleepNs;          ///< time spent sleeping
+        uint32_t mSleepReqUs;       ///< requested sleep time
+        uint32_t mReqSz;            ///< request size
+        int32_t  mResult;           ///< response size or NetMdErr
+        uint16_t mPolls;            ///< response length polls
+        uint8_t  mKind;             ///< see Kind
+        uint8_t  mStatus;           ///< NetMD status (0 -> none)
+        uint8_t  mOpc[OPC_BYTES];   ///< first command bytes
+    };
+
+    //--------------------------------------------------------------------------
+    //! @brief      This class describes a trace scope. The event is recorded
+    //!             when the scope ends.
+    //--------------------------------------------------------------------------
+    class Scope
+    {
+    public:
+        //--------------------------------------------------------------------------
+        //! @brief      Constructs a new instance.
+        //!
+        //! @param      trc     The trace
+        //! @param[in]  kind    The kind
+        //! @param[in]  cmd     The command (optional)
+        //! @param[in]  cmdLen  The command length
+        //--------------------------------------------------------------------------
+        Scope(CNetMdTrace& trc, Kind kind, const uint8_t* cmd = nullptr, size_t cmdLen = 0);
+
+        //--------------------------------------------------------------------------
+        //! @brief      Destroys the object; records the event.
+        //--------------------------------------------------------------------------
+        ~Scope();
+
+        //--------------------------------------------------------------------------
+        //! @brief      store result
+        //!
+        //! @param[in]  ret     The response size or NetMdErr
+        //! @param[in]  status  The NetMD status (optional)
+        //!
+        //! @return     ret
+        //--------------------------------------------------------------------------
+        int done(int ret, uint8_t status = 0);
+
+    private:
+        friend class CNetMdTrace;
+
+        /// the trace
+        CNetMdTrace& mTrc;
+
+        /// enclosing scope
+        Scope* mpParent;
+
+        /// the event
+        Event mEvt;
+
+        /// start time
+        std::chrono::steady_clock::time_point mStart;
+
+        /// tracing enabled on construction
+        bool mActive;
+    };
+
+    //--------------------------------------------------------------------------
+    //! @brief      Constructs a new instance (disabled).
+    //--------------------------------------------------------------------------
+    CNetMdTrace();
+
+    //--------------------------------------------------------------------------
+    //! @brief      enable / disable trace; drops recorded events
+    //!
+    //! @param[in]  events  The ring size in events (0 -> disable)
+    //--------------------------------------------------------------------------
+    void enable(size_t events);
+
+    //--------------------------------------------------------------------------
+    //! @brief      is trace enabled?
+    //!
+    //! @return     true if so
+    //--------------------------------------------------------------------------
+    bool enabled() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      add sleep time to the current scope
+    //!
+    //! @param[in]  reqUs  The requested sleep time in us
+    //! @param[in]  real   The real sleep time
+    //--------------------------------------------------------------------------
+    void slept(uint32_t reqUs, std::chrono::nanoseconds real);
+
+    //--------------------------------------------------------------------------
+    //! @brief      export recorded events as Chrome trace JSON
+    //!
+    //! @param      os    The stream to write to
+    //!
+    //! @return     number of exported events
+    //--------------------------------------------------------------------------
+    size_t exportJson(std::ostream& os) const;
+
+private:
+    //--------------------------------------------------------------------------
+    //! @brief      put event into ring
+    //!
+    //! @param[in]  evt   The event
+    //--------------------------------------------------------------------------
+    void record(const Event& evt);
+
+    /// event ring
+    std::vector<Event> mRing;
+
+    /// next ring position
+    size_t mNext;
+
+    /// number of recorded events (max. ring size)
+    size_t mCount;
+
+    /// innermost open scope
+    Scope* mpTop;
+
+    /// trace start
+    std::chrono::steady_clock::time_point mT0;
+};
+
+} // ~namespace
@@ -0,0 +1,1546 @@
+/*
+ * CNetMdUTOC.cpp
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "CNetMdUTOC.h"
+#include "CNetMdTOC.h"
+#include "log.h"
+#include "md_toc_utils.h"
+#include "netmd_utils.h"
+
+namespace netmd {
+
+//--------------------------------------------------------------------------
+//! @brief      Constructs a new instance.
+//--------------------------------------------------------------------------
+CNetMdUTOC::CNetMdUTOC()
+    :mDirty(0), mUsedFrags{0,}, mUsedCells{{0,},}, mUsedTimes{0,}, mSlotMapsValid(false)
+{
+}
+
+//--------------------------------------------------------------------------
+//! @brief      load one UTOC sector
+//!
+//! @param[in]  sector  The sector number (0, 1, 2, 4)
+//! @param[in]  data    The sector data (SECTOR_SIZE bytes)
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::load(uint8_t sector, const NetMDByteVector& data)
+{
+    if ((sector >= SECTOR_COUNT) || (data.size() != SECTOR_SIZE))
+    {
+        mLOG(CRITICAL) << "Invalid UTOC sector " << static_cast<int>(sector)
+                       << " (" << data.size() << " bytes)!";
+        return -1;
+    }
+
+    mSectors[sector] = data;
+    mDirty          &= ~(1 << sector);
+    mSlotMapsValid   = false;
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get one UTOC sector as it has to be written to the disc
+//!
+//! @param[in]  sector  The sector number (0, 1, 2, 4)
+//!
+//! @return     sector data; empty if not loaded
+//--------------------------------------------------------------------------
+NetMDByteVector CNetMdUTOC::store(uint8_t sector) const
+{
+    return loaded(sector) ? mSectors[sector] : NetMDByteVector{};
+}
+
+//--------------------------------------------------------------------------
+//! @brief      load an UTOC image file (sectors 0 ... n back to back)
+//!
+//! @param[in]  fName  The file name
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::loadFile(const std::string& fName)
+{
+    std::ifstream file(fName, std::ios_base::in | std::ios_base::binary);
+
+    if (!file)
+    {
+        mLOG(CRITICAL) << "Can't open UTOC image " << fName;
+        return -1;
+    }
+
+    NetMDByteVector data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if ((data.size() < (SECTOR_SIZE * 3)) || (data.size() % SECTOR_SIZE))
+    {
+        mLOG(CRITICAL) << "UTOC image " << fName << " has an invalid size: " << data.size();
+        return -1;
+    }
+
+    size_t sectors = std::min(data.size() / SECTOR_SIZE, static_cast<size_t>(SECTOR_COUNT));
+
+    for (size_t i = 0; i < SECTOR_COUNT; i++)
+    {
+        mSectors[i].clear();
+    }
+
+    for (size_t i = 0; i < sectors; i++)
+    {
+        auto first = data.begin() + i * SECTOR_SIZE;
+        load(static_cast<uint8_t>(i), NetMDByteVector(first, first + SECTOR_SIZE));
+    }
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      save UTOC image to file; sectors in between which
+//!             weren't loaded are written as zeros.
+//!
+//! @param[in]  fName  The file name
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::saveFile(const std::string& fName) const
+{
+    int last = SECTOR_COUNT - 1;
+    while ((last >= 0) && !loaded(last))
+    {
+        last--;
+    }
+
+    if (last < 0)
+    {
+        return -1;
+    }
+
+    std::ofstream file(fName, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+    if (!file)
+    {
+        mLOG(CRITICAL) << "Can't create UTOC image " << fName;
+        return -1;
+    }
+
+    // we always write at least sectors 0 ... 2
+    NetMDByteVector empty(SECTOR_SIZE, 0);
+    for (int i = 0; i <= std::max(last, 2); i++)
+    {
+        const NetMDByteVector& s = loaded(i) ? mSectors[i] : empty;
+        file.write(reinterpret_cast<const char*>(s.data()), s.size());
+    }
+
+    return file ? 0 : -1;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      compare with another image block wise
+//!
+//! @param[in]  other  The other image
+//!
+//! @return     runs of changed blocks
+//--------------------------------------------------------------------------
+CNetMdUTOC::DiffBlocks CNetMdUTOC::diff(const CNetMdUTOC& other) const
+{
+    DiffBlocks ret;
+
+    for (uint8_t s = 0; s < SECTOR_COUNT; s++)
+    {
+        if (!loaded(s) && !other.loaded(s))
+        {
+            continue;
+        }
+
+        if (!loaded(s) || !other.loaded(s))
+        {
+            ret.push_back({s, 0, static_cast<uint16_t>(SECTOR_SIZE)});
+            continue;
+        }
+
+        const uint8_t* a = mSectors[s].data();
+        const uint8_t* b = other.mSectors[s].data();
+
+        for (size_t offs = 0; offs < SECTOR_SIZE; offs += BLOCK_SIZE)
+        {
+            if (memcmp(a + offs, b + offs, BLOCK_SIZE) == 0)
+            {
+                continue;
+            }
+
+            // extend run if it directly follows the last one
+            if (!ret.empty() && (ret.back().mSector == s)
+                && ((ret.back().mOffset + ret.back().mSize) == offs))
+            {
+                ret.back().mSize += BLOCK_SIZE;
+            }
+            else
+            {
+                ret.push_back({s, static_cast<uint16_t>(offs), static_cast<uint16_t>(BLOCK_SIZE)});
+            }
+        }
+    }
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      check image consistency: link cycles, overlapping
+//!             fragments, dangling title links and bad addresses
+//!
+//! @param[out] errors  The errors found
+//!
+//! @return     0 -> ok; -1 -> errors found
+//--------------------------------------------------------------------------
+int CNetMdUTOC::validate(std::vector<std::string>& errors) const
+{
+    errors.clear();
+
+    const toc::UTOC_0* pT = pos();
+
+    if (!pT)
+    {
+        errors.push_back("Address sector not loaded!");
+        return -1;
+    }
+
+    // fragments: every slot may be part of exactly one chain
+    struct Owned { Range mRange; int mTrack; };
+    std::vector<Owned> owned;
+    SlotMap used = {0,};
+
+    for (int t = 0; t <= pT->ntracks; t++)
+    {
+        uint8_t slot = pT->trackmap[t];
+
+        if ((slot == 0) && (t != 0))
+        {
+            errors.push_back("Track " + std::to_string(t) + " has no fragment.");
+        }
+
+        for (; slot != 0; slot = pT->fraglist[slot].link)
+        {
+            if (toc::slotUsed(used, slot))
+            {
+                errors.push_back("Track " + std::to_string(t) + ": fragment " + std::to_string(slot)
+                                 + " linked twice (cycle or shared chain).");
+                break;
+            }
+            toc::markSlot(used, slot, true);
+
+            const toc::fragment& f = pT->fraglist[slot];
+
+            if (!validAddr(f.start) || !validAddr(f.end))
+            {
+                errors.push_back("Track " + std::to_string(t) + ": fragment " + std::to_string(slot)
+                                 + " has a bad address.");
+                continue;
+            }
+
+            uint32_t start = CSG::fromCsg(f.start);
+            uint32_t end   = CSG::fromCsg(f.end);
+
+            if (start > end)
+            {
+                errors.push_back("Track " + std::to_string(t) + ": fragment " + std::to_string(slot)
+                                 + " ends before it starts.");
+                continue;
+            }
+            owned.push_back({{start, end, f.mode}, t});
+        }
+    }
+
+    // there are at most 255 fragments
+    std::sort(owned.begin(), owned.end(), [](const Owned& a, const Owned& b)
+    {
+        return a.mRange.mStart < b.mRange.mStart;
+    });
+
+    // compare against the fragment reaching furthest so far
+    for (size_t i = 1, last = 0; i < owned.size(); i++)
+    {
+        if (owned[i].mRange.mStart <= owned[last].mRange.mEnd)
+        {
+            errors.push_back("Fragments of track " + std::to_string(owned[last].mTrack) + " and "
+                             + std::to_string(owned[i].mTrack) + " overlap at group "
+                             + std::to_string(owned[i].mRange.mStart)
+                             + " (track 0 is the free list).");
+        }
+
+        if (owned[i].mRange.mEnd > owned[last].mRange.mEnd)
+        {
+            last = i;
+        }
+    }
+
+    SlotMap freeSlots = {0,};
+    for (uint8_t slot = pT->free_track_slot; slot != 0; slot = pT->fraglist[slot].link)
+    {
+        if (toc::slotUsed(used, slot) || toc::slotUsed(freeSlots, slot))
+        {
+            errors.push_back("Free fragment chain: slot " + std::to_string(slot)
+                             + " is in use or linked twice.");
+            break;
+        }
+        toc::markSlot(freeSlots, slot, true);
+    }
+
+    // titles
+    for (int fw = 0; fw < 2; fw++)
+    {
+        const toc::UTOC_1* pTt = titles(fw != 0);
+
+        if (!pTt)
+        {
+            continue;
+        }
+
+        const char* name = fw ? "Full width title" : "Title";
+        SlotMap     free = {0,};
+        SlotMap     seen = {0,};
+
+        for (uint8_t cell = pTt->free_title_slot; cell != 0; cell = pTt->titlelist[cell].link)
+        {
+            if (toc::slotUsed(free, cell))
+            {
+                errors.push_back(std::string(name) + ": free cell chain has a cycle at "
+                                 + std::to_string(cell) + ".");
+                break;
+            }
+            toc::markSlot(free, cell, true);
+        }
+
+        for (int t = 0; t <= pT->ntracks; t++)
+        {
+            uint8_t cell = pTt->titlemap[t];
+
+            if ((cell == 0) && (t != 0))
+            {
+                continue;
+            }
+
+            // disc title may start in cell 0
+            do
+            {
+                if ((cell != 0) && toc::slotUsed(free, cell))
+                {
+                    errors.push_back(std::string(name) + " of track " + std::to_string(t)
+                                     + " links to free cell " + std::to_string(cell) + ".");
+                    break;
+                }
+
+                if (toc::slotUsed(seen, cell))
+                {
+                    errors.push_back(std::string(name) + " of track " + std::to_string(t)
+                                     + ": cell " + std::to_string(cell)
+                                     + " linked twice (cycle or shared chain).");
+                    break;
+                }
+                toc::markSlot(seen, cell, true);
+                cell = pTt->titlelist[cell].link;
+            }
+            while (cell != 0);
+        }
+    }
+
+    return errors.empty() ? 0 : -1;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      check if sector was loaded
+//!
+//! @param[in]  sector  The sector number
+//!
+//! @return     true if loaded
+//--------------------------------------------------------------------------
+bool CNetMdUTOC::loaded(uint8_t sector) const
+{
+    return (sector < SECTOR_COUNT) && (mSectors[sector].size() == SECTOR_SIZE);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      check if sector was changed since loading
+//!
+//! @param[in]  sector  The sector number
+//!
+//! @return     true if changed
+//--------------------------------------------------------------------------
+bool CNetMdUTOC::dirty(uint8_t sector) const
+{
+    return (sector < SECTOR_COUNT) && (mDirty & (1 << sector));
+}
+
+//--------------------------------------------------------------------------
+//! @brief      mark all sectors as clean (e.g. after writing them)
+//--------------------------------------------------------------------------
+void CNetMdUTOC::clearDirty()
+{
+    mDirty = 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get track count
+//!
+//! @return     number of tracks; -1 if address sector isn't loaded
+//--------------------------------------------------------------------------
+int CNetMdUTOC::trackCount() const
+{
+    return pos() ? pos()->ntracks : -1;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get the audio ranges of a track
+//!
+//! @param[in]  track  The track number (starting with 1)
+//!
+//! @return     ranges in play order
+//--------------------------------------------------------------------------
+CNetMdUTOC::Ranges CNetMdUTOC::trackRanges(int track) const
+{
+    if ((track < 1) || (track > trackCount()))
+    {
+        return Ranges{};
+    }
+    return readChain(pos()->trackmap[track]);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get the free space on disc
+//!
+//! @return     free ranges in free list order
+//--------------------------------------------------------------------------
+CNetMdUTOC::Ranges CNetMdUTOC::freeRanges() const
+{
+    return pos() ? readChain(pos()->trackmap[0]) : Ranges{};
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get the length of a track in sound groups
+//!
+//! @param[in]  track  The track number (starting with 1)
+//!
+//! @return     sound groups
+//--------------------------------------------------------------------------
+uint32_t CNetMdUTOC::trackGroups(int track) const
+{
+    uint32_t ret = 0;
+    for (const auto& r : trackRanges(track))
+    {
+        ret += r.mEnd - r.mStart + 1;
+    }
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get track title
+//!
+//! @param[in]  track      The track number (0 -> disc title)
+//! @param[in]  fullWidth  use full width title sector
+//!
+//! @return     title
+//--------------------------------------------------------------------------
+std::string CNetMdUTOC::title(int track, bool fullWidth) const
+{
+    std::string s;
+    const toc::UTOC_1* pT = titles(fullWidth);
+
+    if (!pT || (track < 0) || (track > trackCount()))
+    {
+        return s;
+    }
+
+    uint8_t cell = pT->titlemap[track];
+
+    // untitled track
+    if ((cell == 0) && (track != 0))
+    {
+        return s;
+    }
+
+    // the link count guards against cycles
+    for (int links = 0; links < 256; links++)
+    {
+        const toc::titlecell& tc = pT->titlelist[cell];
+        for (int i = 0; (i < 7) && (tc.title[i] != '\0'); i++)
+        {
+            s.push_back(tc.title[i]);
+        }
+
+        if ((cell = tc.link) == 0)
+        {
+            break;
+        }
+    }
+    return s;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      get track time stamp
+//!
+//! @param[in]  track  The track number (0 -> disc)
+//!
+//! @return     time stamp; 0 if not set
+//--------------------------------------------------------------------------
+std::time_t CNetMdUTOC::tstamp(int track) const
+{
+    if (!times() || (track < 0) || (track > trackCount()))
+    {
+        return 0;
+    }
+
+    uint8_t slot = times()->timemap[track];
+
+    if ((slot == 0) && (track != 0))
+    {
+        return 0;
+    }
+
+    const toc::timestamp& ts = times()->timelist[slot];
+
+    return toc::timestampToTime(ts);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      set track title; the old title cells are released
+//!             once the new title fits
+//!
+//! @param[in]  track      The track number (0 -> disc title)
+//! @param[in]  title      The title (empty removes it)
+//! @param[in]  fullWidth  use full width title sector
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::setTitle(int track, const std::string& title, bool fullWidth)
+{
+    toc::UTOC_1* pT = titles(fullWidth);
+
+    if (!pT || (track < 0) || (track > trackCount()))
+    {
+        return -1;
+    }
+
+    buildSlotMaps();
+
+    // build the new chain first; the old title is
+    // released only when the new one fits
+    uint8_t head = 0;
+    uint8_t prev = 0;
+    for (size_t sz = 0; sz < title.size(); sz += 7)
+    {
+        uint8_t cell = allocCell(fullWidth);
+
+        if (cell == 0)
+        {
+            mLOG(CRITICAL) << "No free title cell left!";
+            while (head != 0)
+            {
+                uint8_t next = pT->titlelist[head].link;
+                releaseCell(fullWidth, head);
+                head = next;
+            }
+            return -1;
+        }
+
+        toc::titlecell& tc = pT->titlelist[cell];
+        memset(tc.title, 0, sizeof(tc.title));
+        title.copy(tc.title, 7, sz);
+
+        if (prev == 0)
+        {
+            head = cell;
+        }
+        else
+        {
+            pT->titlelist[prev].link = cell;
+        }
+        prev = cell;
+    }
+
+    releaseTitle(track, fullWidth);
+    pT->titlemap[track] = head;
+
+    touch(fullWidth ? FW_SECTOR : HW_SECTOR);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      set track time stamp
+//!
+//! @param[in]  track   The track number (0 -> disc)
+//! @param[in]  tstamp  The time stamp
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::setTStamp(int track, std::time_t tstamp)
+{
+    toc::UTOC_2* pT = times();
+    auto*        tm = gmtime(&tstamp);
+
+    if (!pT || !tm || (track < 0) || (track > trackCount()))
+    {
+        return -1;
+    }
+
+    buildSlotMaps();
+
+    uint8_t slot = pT->timemap[track];
+
+    if ((slot == 0) && (track != 0))
+    {
+        int free = toc::firstFreeSlot(mUsedTimes);
+        if (free < 0)
+        {
+            mLOG(CRITICAL) << "No free time stamp slot left!";
+            return -1;
+        }
+        slot = static_cast<uint8_t>(free);
+        toc::markSlot(mUsedTimes, slot, true);
+        pT->timemap[track] = slot;
+        free = toc::firstFreeSlot(mUsedTimes);
+        pT->free_time_slot = (free < 0) ? 0 : free;
+    }
+
+    toc::timestamp& ts = pT->timelist[slot];
+    toc::setTimestamp(ts, *tm);
+    ts.signature = toBigEndian(toc::SIGNATURE);
+
+    touch(TS_SECTOR);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      take space from the free list (first fit in free list order)
+//!
+//! @param[in]  groups  The number of sound groups needed
+//! @param[in]  mode    The track mode for the returned ranges
+//! @param[out] ranges  The ranges taken
+//!
+//! @return     0 -> ok; -1 -> not enough free space
+//--------------------------------------------------------------------------
+int CNetMdUTOC::claimFree(uint32_t groups, uint8_t mode, Ranges& ranges)
+{
+    Ranges free = freeRanges();
+    ranges.clear();
+
+    for (auto it = free.begin(); (it != free.end()) && (groups > 0);)
+    {
+        uint32_t len = it->mEnd - it->mStart + 1;
+        if (len <= groups)
+        {
+            ranges.push_back({it->mStart, it->mEnd, mode});
+            groups -= len;
+            it      = free.erase(it);
+        }
+        else
+        {
+            ranges.push_back({it->mStart, it->mStart + groups - 1, mode});
+            it->mStart += groups;
+            groups      = 0;
+        }
+    }
+
+    if (groups > 0)
+    {
+        mLOG(CRITICAL) << "Not enough free space on disc!";
+        ranges.clear();
+        return -1;
+    }
+
+    return writeFreeList(free);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      insert a new track; ranges must not be used by any track
+//!
+//! Parts of the ranges found in the free list are removed from it.
+//! Following tracks are shifted up.
+//!
+//! @param[in]  track   The new track number (1 ... trackCount() + 1)
+//! @param[in]  ranges  The audio ranges in play order
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::insertTrack(int track, const Ranges& ranges)
+{
+    int tracks = trackCount();
+
+    if ((tracks < 0) || (tracks >= 255) || (track < 1) || (track > (tracks + 1)) || ranges.empty())
+    {
+        return -1;
+    }
+
+    auto overlaps = [](const Range& a, const Range& b)
+    {
+        return (a.mStart <= b.mEnd) && (b.mStart <= a.mEnd);
+    };
+
+    for (int t = 1; t <= tracks; t++)
+    {
+        for (const auto& used : trackRanges(t))
+        {
+            for (const auto& r : ranges)
+            {
+                if ((r.mStart > r.mEnd) || overlaps(r, used))
+                {
+                    mLOG(CRITICAL) << "Range " << r.mStart << " ... " << r.mEnd
+                                   << " is invalid or used by track " << t << "!";
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // cut new ranges out of the free list
+    Ranges free;
+    for (const auto& f : freeRanges())
+    {
+        Ranges parts{f};
+        for (const auto& r : ranges)
+        {
+            Ranges rest;
+            for (const auto& p : parts)
+            {
+                if (!overlaps(p, r))
+                {
+                    rest.push_back(p);
+                    continue;
+                }
+                if (p.mStart < r.mStart)
+                {
+                    rest.push_back({p.mStart, r.mStart - 1, p.mMode});
+                }
+                if (p.mEnd > r.mEnd)
+                {
+                    rest.push_back({r.mEnd + 1, p.mEnd, p.mMode});
+                }
+            }
+            parts.swap(rest);
+        }
+        free.insert(free.end(), parts.begin(), parts.end());
+    }
+
+    buildSlotMaps();
+
+    uint8_t head = writeChain(ranges);
+
+    if ((head == 0) || (writeFreeList(free) != 0))
+    {
+        mLOG(CRITICAL) << "No free fragment slot left!";
+        releaseChain(head);
+        return -1;
+    }
+
+    shiftMaps(track, tracks, 1);
+    pos()->trackmap[track] = head;
+    pos()->ntracks++;
+    touch(POS_SECTOR);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      erase a track; its audio is given back to the free list,
+//!             titles and time stamp are released.
+//!
+//! @param[in]  track  The track number (starting with 1)
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::eraseTrack(int track)
+{
+    int tracks = trackCount();
+
+    if ((track < 1) || (track > tracks))
+    {
+        return -1;
+    }
+
+    buildSlotMaps();
+
+    Ranges free = freeRanges();
+    Ranges used = trackRanges(track);
+    free.insert(free.end(), used.begin(), used.end());
+
+    releaseChain(pos()->trackmap[track]);
+    pos()->trackmap[track] = 0;
+
+    if (writeFreeList(free) != 0)
+    {
+        return -1;
+    }
+
+    dropTrack(track);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      move a track
+//!
+//! @param[in]  from  The source track number (starting with 1)
+//! @param[in]  to    The destination track number (starting with 1)
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::moveTrack(int from, int to)
+{
+    int tracks = trackCount();
+
+    if ((from < 1) || (from > tracks) || (to < 1) || (to > tracks))
+    {
+        return -1;
+    }
+
+    if (from == to)
+    {
+        return 0;
+    }
+
+    toc::UTOC_1* pHw = titles(false);
+    toc::UTOC_1* pFw = titles(true);
+    toc::UTOC_2* pTs = times();
+
+    uint8_t frag = pos()->trackmap[from];
+    uint8_t hw   = pHw ? pHw->titlemap[from] : 0;
+    uint8_t fw   = pFw ? pFw->titlemap[from] : 0;
+    uint8_t ts   = pTs ? pTs->timemap[from]  : 0;
+
+    if (from < to)
+    {
+        shiftMaps(from + 1, to, -1);
+    }
+    else
+    {
+        shiftMaps(to, from - 1, 1);
+    }
+
+    pos()->trackmap[to] = frag;
+    if (pHw) pHw->titlemap[to] = hw;
+    if (pFw) pFw->titlemap[to] = fw;
+    if (pTs) pTs->timemap[to]  = ts;
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      split a track; the second part becomes the next track
+//!             (without title and time stamp), following tracks are
+//!             shifted up.
+//!
+//! @param[in]  track   The track number (starting with 1)
+//! @param[in]  groups  The split position in sound groups from track start
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::splitTrack(int track, uint32_t groups)
+{
+    int tracks = trackCount();
+
+    if ((track < 1) || (track > tracks) || (tracks >= 255)
+        || (groups == 0) || (groups >= trackGroups(track)))
+    {
+        return -1;
+    }
+
+    buildSlotMaps();
+
+    toc::UTOC_0* pT   = pos();
+    uint8_t      prev = 0;
+    uint8_t      slot = pT->trackmap[track];
+    uint8_t      head = 0;
+
+    // find the fragment holding the split position
+    for (uint32_t done = 0; slot != 0; prev = slot, slot = pT->fraglist[slot].link)
+    {
+        toc::fragment& f     = pT->fraglist[slot];
+        uint32_t       start = CSG::fromCsg(f.start);
+        uint32_t       len   = CSG::fromCsg(f.end) - start + 1;
+
+        if (groups == done)
+        {
+            // split at fragment border: just cut the chain
+            pT->fraglist[prev].link = 0;
+            head = slot;
+            break;
+        }
+
+        if (groups < (done + len))
+        {
+            if ((head = allocFrag()) == 0)
+            {
+                mLOG(CRITICAL) << "No free fragment slot left!";
+                return -1;
+            }
+
+            toc::fragment& n = pT->fraglist[head];
+            n.start = CSG::fromGroups(start + (groups - done));
+            n.end   = f.end;
+            n.mode  = f.mode;
+            n.link  = f.link;
+            f.end   = CSG::fromGroups(start + (groups - done) - 1);
+            f.link  = 0;
+            break;
+        }
+        done += len;
+    }
+
+    if (head == 0)
+    {
+        return -1;
+    }
+
+    shiftMaps(track + 1, tracks, 1);
+    pT->trackmap[track + 1] = head;
+    pT->ntracks++;
+    touch(POS_SECTOR);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      join two tracks; the audio of the second track is appended
+//!             to the first one, the second track is removed.
+//!
+//! @param[in]  first   The first track number (starting with 1)
+//! @param[in]  second  The second track number (starting with 1)
+//!
+//! @return     0 -> ok; -1 -> error
+//--------------------------------------------------------------------------
+int CNetMdUTOC::joinTracks(int first, int second)
+{
+    int tracks = trackCount();
+
+    if ((first < 1) || (first > tracks) || (second < 1) || (second > tracks) || (first == second))
+    {
+        return -1;
+    }
+
+    toc::UTOC_0* pT = pos();
+    uint8_t      a  = pT->trackmap[first];
+    uint8_t      b  = pT->trackmap[second];
+
+    if ((a == 0) || (b == 0) || (pT->fraglist[a].mode != pT->fraglist[b].mode))
+    {
+        mLOG(CRITICAL) << "Tracks " << first << " and " << second << " can't be joined!";
+        return -1;
+    }
+
+    buildSlotMaps();
+
+    // find end of first chain
+    while (pT->fraglist[a].link != 0)
+    {
+        a = pT->fraglist[a].link;
+    }
+
+    toc::fragment& fa = pT->fraglist[a];
+    toc::fragment& fb = pT->fraglist[b];
+
+    if ((CSG::fromCsg(fa.end) + 1) == CSG::fromCsg(fb.start))
+    {
+        // audio is contiguous on disc: merge both fragments
+        fa.end  = fb.end;
+        fa.link = fb.link;
+        fb.link = 0;
+        releaseFrag(b);
+    }
+    else
+    {
+        fa.link = b;
+    }
+
+    pT->trackmap[second] = 0;
+    dropTrack(second);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      typed access to sector images
+//--------------------------------------------------------------------------
+toc::UTOC_0* CNetMdUTOC::pos()
+{
+    return loaded(POS_SECTOR) ? reinterpret_cast<toc::UTOC_0*>(mSectors[POS_SECTOR].data()) : nullptr;
+}
+
+const toc::UTOC_0* CNetMdUTOC::pos() const
+{
+    return loaded(POS_SECTOR) ? reinterpret_cast<const toc::UTOC_0*>(mSectors[POS_SECTOR].data()) : nullptr;
+}
+
+toc::UTOC_1* CNetMdUTOC::titles(bool fullWidth)
+{
+    uint8_t sector = fullWidth ? FW_SECTOR : HW_SECTOR;
+    return loaded(sector) ? reinterpret_cast<toc::UTOC_1*>(mSectors[sector].data()) : nullptr;
+}
+
+const toc::UTOC_1* CNetMdUTOC::titles(bool fullWidth) const
+{
+    uint8_t sector = fullWidth ? FW_SECTOR : HW_SECTOR;
+    return loaded(sector) ? reinterpret_cast<const toc::UTOC_1*>(mSectors[sector].data()) : nullptr;
+}
+
+toc::UTOC_2* CNetMdUTOC::times()
+{
+    return loaded(TS_SECTOR) ? reinterpret_cast<toc::UTOC_2*>(mSectors[TS_SECTOR].data()) : nullptr;
+}
+
+const toc::UTOC_2* CNetMdUTOC::times() const
+{
+    return loaded(TS_SECTOR) ? reinterpret_cast<const toc::UTOC_2*>(mSectors[TS_SECTOR].data()) : nullptr;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      rebuild occupancy bitmaps and free slot chains if needed
+//--------------------------------------------------------------------------
+void CNetMdUTOC::buildSlotMaps()
+{
+    if (mSlotMapsValid)
+    {
+        return;
+    }
+
+    memset(mUsedFrags, 0, sizeof(mUsedFrags));
+    memset(mUsedCells, 0, sizeof(mUsedCells));
+    memset(mUsedTimes, 0, sizeof(mUsedTimes));
+
+    // slot 0 is never free
+    toc::markSlot(mUsedFrags, 0, true);
+    toc::markSlot(mUsedCells[0], 0, true);
+    toc::markSlot(mUsedCells[1], 0, true);
+    toc::markSlot(mUsedTimes, 0, true);
+
+    int tracks = std::max(trackCount(), 0);
+
+    // Re-link the free slots if the chain doesn't hold all of them.
+    // The link count guards against cycles.
+    auto relink = [](SlotMap& used, auto& list, uint8_t& head)
+    {
+        int  free = 0;
+        for (int s = 1; s < 256; s++)
+        {
+            free += toc::slotUsed(used, s) ? 0 : 1;
+        }
+
+        SlotMap seen = {0,};
+        int     cnt  = 0;
+        for (uint8_t s = head; (s != 0) && (cnt <= free); s = list[s].link, cnt++)
+        {
+            if (toc::slotUsed(used, s) || toc::slotUsed(seen, s))
+            {
+                cnt = -1;
+                break;
+            }
+            toc::markSlot(seen, s, true);
+        }
+
+        if (cnt == free)
+        {
+            return false;
+        }
+
+        uint8_t* pLink = &head;
+        for (int s = 1; s < 256; s++)
+        {
+            if (!toc::slotUsed(used, s))
+            {
+                *pLink = s;
+                pLink  = &list[s].link;
+            }
+        }
+        *pLink = 0;
+        return true;
+    };
+
+    if (toc::UTOC_0* pT = pos())
+    {
+        for (int t = 0; t <= tracks; t++)
+        {
+            for (uint8_t s = pT->trackmap[t]; (s != 0) && !toc::slotUsed(mUsedFrags, s); s = pT->fraglist[s].link)
+            {
+                toc::markSlot(mUsedFrags, s, true);
+            }
+        }
+
+        if (relink(mUsedFrags, pT->fraglist, pT->free_track_slot))
+        {
+            mLOG(DEBUG) << "Free fragment chain rebuilt.";
+            touch(POS_SECTOR);
+        }
+    }
+
+    for (int fw = 0; fw < 2; fw++)
+    {
+        if (toc::UTOC_1* pT = titles(fw != 0))
+        {
+            for (int t = 0; t <= tracks; t++)
+            {
+                uint8_t s = pT->titlemap[t];
+                if ((s == 0) && (t != 0))
+                {
+                    continue;
+                }
+
+                // disc title may start in cell 0
+                do
+                {
+                    if ((s != 0) && toc::slotUsed(mUsedCells[fw], s)) break;
+                    toc::markSlot(mUsedCells[fw], s, true);
+                    s = pT->titlelist[s].link;
+                }
+                while (s != 0);
+            }
+
+            if (relink(mUsedCells[fw], pT->titlelist, pT->free_title_slot))
+            {
+                mLOG(DEBUG) << "Free title chain rebuilt.";
+                touch(fw ? FW_SECTOR : HW_SECTOR);
+            }
+        }
+    }
+
+    if (const toc::UTOC_2* pT = times())
+    {
+        for (int t = 1; t <= tracks; t++)
+        {
+            toc::markSlot(mUsedTimes, pT->timemap[t], true);
+        }
+    }
+
+    mSlotMapsValid = true;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      allocate a fragment slot
+//!
+//! @return     slot; 0 if none left
+//--------------------------------------------------------------------------
+uint8_t CNetMdUTOC::allocFrag()
+{
+    toc::UTOC_0* pT   = pos();
+    uint8_t      slot = pT ? pT->free_track_slot : 0;
+
+    if (slot != 0)
+    {
+        pT->free_track_slot     = pT->fraglist[slot].link;
+        pT->fraglist[slot].link = 0;
+        toc::markSlot(mUsedFrags, slot, true);
+    }
+    return slot;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      give a fragment slot back
+//!
+//! @param[in]  slot  The slot
+//--------------------------------------------------------------------------
+void CNetMdUTOC::releaseFrag(uint8_t slot)
+{
+    toc::UTOC_0* pT = pos();
+
+    if (pT && (slot != 0) && toc::slotUsed(mUsedFrags, slot))
+    {
+        memset(&pT->fraglist[slot], 0, sizeof(toc::fragment));
+        pT->fraglist[slot].link = pT->free_track_slot;
+        pT->free_track_slot     = slot;
+        toc::markSlot(mUsedFrags, slot, false);
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      allocate a title cell
+//!
+//! @param[in]  fullWidth  use full width title sector
+//!
+//! @return     cell; 0 if none left
+//--------------------------------------------------------------------------
+uint8_t CNetMdUTOC::allocCell(bool fullWidth)
+{
+    toc::UTOC_1* pT   = titles(fullWidth);
+    uint8_t      cell = pT ? pT->free_title_slot : 0;
+
+    if (cell != 0)
+    {
+        pT->free_title_slot      = pT->titlelist[cell].link;
+        pT->titlelist[cell].link = 0;
+        toc::markSlot(mUsedCells[fullWidth ? 1 : 0], cell, true);
+    }
+    return cell;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      give a title cell back
+//!
+//! @param[in]  fullWidth  use full width title sector
+//! @param[in]  cell       The cell
+//--------------------------------------------------------------------------
+void CNetMdUTOC::releaseCell(bool fullWidth, uint8_t cell)
+{
+    toc::UTOC_1* pT = titles(fullWidth);
+    SlotMap&     m  = mUsedCells[fullWidth ? 1 : 0];
+
+    if (pT && (cell != 0) && toc::slotUsed(m, cell))
+    {
+        memset(&pT->titlelist[cell], 0, sizeof(toc::titlecell));
+        pT->titlelist[cell].link = pT->free_title_slot;
+        pT->free_title_slot      = cell;
+        toc::markSlot(m, cell, false);
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      release the title chain of a track
+//!
+//! @param[in]  track      The track number
+//! @param[in]  fullWidth  use full width title sector
+//--------------------------------------------------------------------------
+void CNetMdUTOC::releaseTitle(int track, bool fullWidth)
+{
+    toc::UTOC_1* pT = titles(fullWidth);
+
+    if (!pT)
+    {
+        return;
+    }
+
+    uint8_t cell = pT->titlemap[track];
+
+    if ((cell == 0) && (track != 0))
+    {
+        return;
+    }
+
+    // cell 0 is never released, only cleared
+    for (int links = 0; links < 256; links++)
+    {
+        uint8_t next = pT->titlelist[cell].link;
+
+        if (cell == 0)
+        {
+            memset(&pT->titlelist[0], 0, sizeof(toc::titlecell));
+        }
+        else if (!toc::slotUsed(mUsedCells[fullWidth ? 1 : 0], cell))
+        {
+            break;
+        }
+        else
+        {
+            releaseCell(fullWidth, cell);
+        }
+
+        if ((cell = next) == 0)
+        {
+            break;
+        }
+    }
+
+    pT->titlemap[track] = 0;
+    touch(fullWidth ? FW_SECTOR : HW_SECTOR);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write ranges into a new fragment chain
+//!
+//! @param[in]  ranges  The ranges
+//!
+//! @return     first slot; 0 on error
+//--------------------------------------------------------------------------
+uint8_t CNetMdUTOC::writeChain(const Ranges& ranges)
+{
+    toc::UTOC_0* pT   = pos();
+    uint8_t      head = 0;
+    uint8_t      prev = 0;
+
+    for (const auto& r : ranges)
+    {
+        uint8_t slot = allocFrag();
+
+        if (slot == 0)
+        {
+            releaseChain(head);
+            return 0;
+        }
+
+        toc::fragment& f = pT->fraglist[slot];
+        f.start = CSG::fromGroups(r.mStart);
+        f.end   = CSG::fromGroups(r.mEnd);
+        f.mode  = r.mMode;
+
+        if (prev == 0)
+        {
+            head = slot;
+        }
+        else
+        {
+            pT->fraglist[prev].link = slot;
+        }
+        prev = slot;
+    }
+
+    touch(POS_SECTOR);
+    return head;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      read ranges of a fragment chain
+//!
+//! @param[in]  slot  The first slot
+//!
+//! @return     ranges
+//--------------------------------------------------------------------------
+CNetMdUTOC::Ranges CNetMdUTOC::readChain(uint8_t slot) const
+{
+    Ranges ret;
+    const toc::UTOC_0* pT = pos();
+
+    // the link count guards against cycles
+    for (int links = 0; pT && (slot != 0) && (links < 256); links++)
+    {
+        const toc::fragment& f = pT->fraglist[slot];
+        ret.push_back({CSG::fromCsg(f.start), CSG::fromCsg(f.end), f.mode});
+        slot = f.link;
+    }
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      release a fragment chain
+//!
+//! @param[in]  slot  The first slot
+//--------------------------------------------------------------------------
+void CNetMdUTOC::releaseChain(uint8_t slot)
+{
+    toc::UTOC_0* pT = pos();
+
+    while (pT && (slot != 0) && toc::slotUsed(mUsedFrags, slot))
+    {
+        uint8_t next = pT->fraglist[slot].link;
+        releaseFrag(slot);
+        slot = next;
+    }
+    touch(POS_SECTOR);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      replace the free list (sorted, adjacent ranges merged)
+//!
+//! @param[in]  ranges  The free ranges
+//!
+//! @return     0 -> ok; -1 -> out of fragment slots
+//--------------------------------------------------------------------------
+int CNetMdUTOC::writeFreeList(Ranges ranges)
+{
+    toc::UTOC_0* pT = pos();
+
+    if (!pT)
+    {
+        return -1;
+    }
+
+    buildSlotMaps();
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b)
+    {
+        return a.mStart < b.mStart;
+    });
+
+    Ranges merged;
+    for (const auto& r : ranges)
+    {
+        if (!merged.empty() && (r.mStart <= (merged.back().mEnd + 1)))
+        {
+            merged.back().mEnd = std::max(merged.back().mEnd, r.mEnd);
+        }
+        else
+        {
+            merged.push_back(r);
+        }
+    }
+
+    // reuse the slots of the current free list; only entries
+    // which really change are written
+    uint8_t* pLink = &pT->trackmap[0];
+    for (const auto& r : merged)
+    {
+        uint8_t slot = *pLink;
+
+        if (slot == 0)
+        {
+            if ((slot = allocFrag()) == 0)
+            {
+                return -1;
+            }
+            *pLink = slot;
+        }
+
+        toc::fragment& f = pT->fraglist[slot];
+
+        // a free range has no track mode
+        if (f.mode != 0)
+        {
+            f.mode = 0;
+        }
+
+        if (CSG::fromCsg(f.start) != r.mStart)
+        {
+            f.start = CSG::fromGroups(r.mStart);
+        }
+
+        if (CSG::fromCsg(f.end) != r.mEnd)
+        {
+            f.end = CSG::fromGroups(r.mEnd);
+        }
+
+        pLink = &f.link;
+    }
+
+    // release what's left
+    releaseChain(*pLink);
+    *pLink = 0;
+
+    touch(POS_SECTOR);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      release titles and time stamp of a track and remove its
+//!             entries from the track maps
+//!
+//! @param[in]  track  The track number (audio must be released already)
+//--------------------------------------------------------------------------
+void CNetMdUTOC::dropTrack(int track)
+{
+    releaseTitle(track, false);
+
+    if (loaded(FW_SECTOR))
+    {
+        releaseTitle(track, true);
+    }
+
+    if (toc::UTOC_2* pT = times())
+    {
+        uint8_t slot = pT->timemap[track];
+        if (slot != 0)
+        {
+            memset(&pT->timelist[slot], 0, sizeof(toc::timestamp));
+            toc::markSlot(mUsedTimes, slot, false);
+            pT->timemap[track] = 0;
+            int free = toc::firstFreeSlot(mUsedTimes);
+            pT->free_time_slot = (free < 0) ? 0 : free;
+            touch(TS_SECTOR);
+        }
+    }
+
+    shiftMaps(track + 1, trackCount(), -1);
+    pos()->ntracks--;
+    touch(POS_SECTOR);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      shift the per track maps
+//!
+//! @param[in]  from  first track to shift
+//! @param[in]  to    last track to shift
+//! @param[in]  dir   +1 -> shift up; -1 -> shift down
+//--------------------------------------------------------------------------
+void CNetMdUTOC::shiftMaps(int from, int to, int dir)
+{
+    auto shift = [&](uint8_t* map)
+    {
+        if (from > to)
+        {
+            // nothing to shift, but the open entry has to be cleared
+            map[(dir > 0) ? from : to] = 0;
+            return;
+        }
+
+        if (dir > 0)
+        {
+            memmove(&map[from + 1], &map[from], to - from + 1);
+            map[from] = 0;
+        }
+        else
+        {
+            memmove(&map[from - 1], &map[from], to - from + 1);
+            map[to] = 0;
+        }
+    };
+
+    if (toc::UTOC_0* pT = pos())
+    {
+        shift(pT->trackmap);
+        touch(POS_SECTOR);
+    }
+
+    if (toc::UTOC_1* pT = titles(false))
+    {
+        shift(pT->titlemap);
+        touch(HW_SECTOR);
+    }
+
+    if (toc::UTOC_1* pT = titles(true))
+    {
+        shift(pT->titlemap);
+        touch(FW_SECTOR);
+    }
+
+    if (toc::UTOC_2* pT = times())
+    {
+        shift(pT->timemap);
+        touch(TS_SECTOR);
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      mark sector as changed
+//!
+//! @param[in]  sector  The sector
+//--------------------------------------------------------------------------
+void CNetMdUTOC::touch(uint8_t sector)
+{
+    mDirty |= (1 << sector);
+}
+
+//--------------------------------------------------------------------------
+//! @brief      check a disc address
+//!
+//! @param[in]  addr  The address
+//!
+//! @return     true if valid
+//--------------------------------------------------------------------------
+bool CNetMdUTOC::validAddr(const toc::discaddr& addr)
+{
+    uint8_t sector = ((addr.csg[1] & 0b11) << 4) | (addr.csg[2] >> 4);
+    uint8_t group  = addr.csg[2] & 0xf;
+
+    // 32 sectors per cluster; even sectors hold groups 0 ... 5,
+    // odd sectors groups 5 ... 10 (group 5 spans both)
+    if (sector > 31)
+    {
+        return false;
+    }
+    return (sector & 1) ? ((group >= 5) && (group <= 10)) : (group <= 5);
+}
+
+} // namespace netmd
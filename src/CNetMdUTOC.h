@@ -0,0 +1,480 @@
+/*
+ * CNetMdUTOC.h
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/**
+@file CNetMdUTOC.h
+
+# UTOC model
+While CNetMdTOC only knows how to split one DAO track, this class models
+the whole UTOC: address sector (0) including the free list, half width
+titles (1), time stamps (2) and full width titles (4).
+
+The sectors are kept as raw images. All edits are written straight into
+these images, so that unchanged entries keep their exact bytes and
+store() returns the sector as it has to go back to the disc.
+Only entries touched by an edit are rewritten.
+
+Slot usage (fragments, title cells, time stamps) is tracked in
+occupancy bitmaps. Free fragment- and title slots are kept as chain
+through the link bytes, headed by free_track_slot / free_title_slot.
+
+# Offline use
+UTOC images can be loaded from / saved to files (sectors back to back,
+at least sectors 0 ... 2), compared block wise and validated. This way
+TOC edits can be prepared and checked on the host before spending a
+finalizeTOC() cycle on the device.
+*/
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "md_toc.h"
+#include "md_toc_utils.h"
+#include "netmd_defines.h"
+
+namespace netmd {
+
+//------------------------------------------------------------------------------
+//! @brief      This class models the UTOC of a MiniDisc.
+//------------------------------------------------------------------------------
+class CNetMdUTOC
+{
+public:
+    /// size of one UTOC sector
+    static constexpr size_t  SECTOR_SIZE  = 2352;
+
+    /// number of UTOC sectors we handle (0 ... 4)
+    static constexpr uint8_t SECTOR_COUNT = 5;
+
+    /// address sector
+    static constexpr uint8_t POS_SECTOR   = 0;
+
+    /// half width titles
+    static constexpr uint8_t HW_SECTOR    = 1;
+
+    /// time stamps
+    static constexpr uint8_t TS_SECTOR    = 2;
+
+    /// full width titles (note: on disc this is sector 4)
+    static constexpr uint8_t FW_SECTOR    = 4;
+
+    /// one contiguous range of sound groups (end is inclusive)
+    struct Range
+    {
+        uint32_t mStart;    ///< first sound group
+        uint32_t mEnd;      ///< last sound group
+        uint8_t  mMode;     ///< track mode
+    };
+
+    using Ranges = std::vector<Range>;
+
+    /// block size used for image diff (same as UTOC write blocks)
+    static constexpr size_t  BLOCK_SIZE   = 0x10;
+
+    /// a run of changed bytes in one sector
+    struct DiffBlock
+    {
+        uint8_t  mSector;   ///< sector number
+        uint16_t mOffset;   ///< offset in sector (multiple of BLOCK_SIZE)
+        uint16_t mSize;     ///< size in bytes (multiple of BLOCK_SIZE)
+    };
+
+    using DiffBlocks = std::vector<DiffBlock>;
+
+    //--------------------------------------------------------------------------
+    //! @brief      Constructs a new instance.
+    //--------------------------------------------------------------------------
+    CNetMdUTOC();
+
+    //--------------------------------------------------------------------------
+    //! @brief      load one UTOC sector
+    //!
+    //! @param[in]  sector  The sector number (0, 1, 2, 4)
+    //! @param[in]  data    The sector data (SECTOR_SIZE bytes)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int load(uint8_t sector, const NetMDByteVector& data);
+
+    //--------------------------------------------------------------------------
+    //! @brief      get one UTOC sector as it has to be written to the disc
+    //!
+    //! @param[in]  sector  The sector number (0, 1, 2, 4)
+    //!
+    //! @return     sector data; empty if not loaded
+    //--------------------------------------------------------------------------
+    NetMDByteVector store(uint8_t sector) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      load an UTOC image file (sectors 0 ... n back to back)
+    //!
+    //! @param[in]  fName  The file name
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int loadFile(const std::string& fName);
+
+    //--------------------------------------------------------------------------
+    //! @brief      save UTOC image to file; sectors in between which
+    //!             weren't loaded are written as zeros.
+    //!
+    //! @param[in]  fName  The file name
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int saveFile(const std::string& fName) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      compare with another image block wise
+    //!
+    //! @param[in]  other  The other image
+    //!
+    //! @return     runs of changed blocks
+    //--------------------------------------------------------------------------
+    DiffBlocks diff(const CNetMdUTOC& other) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      check image consistency: link cycles, overlapping
+    //!             fragments, dangling title links and bad addresses
+    //!
+    //! @param[out] errors  The errors found
+    //!
+    //! @return     0 -> ok; -1 -> errors found
+    //--------------------------------------------------------------------------
+    int validate(std::vector<std::string>& errors) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      check if sector was loaded
+    //!
+    //! @param[in]  sector  The sector number
+    //!
+    //! @return     true if loaded
+    //--------------------------------------------------------------------------
+    bool loaded(uint8_t sector) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      check if sector was changed since loading
+    //!
+    //! @param[in]  sector  The sector number
+    //!
+    //! @return     true if changed
+    //--------------------------------------------------------------------------
+    bool dirty(uint8_t sector) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      mark all sectors as clean (e.g. after writing them)
+    //--------------------------------------------------------------------------
+    void clearDirty();
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track count
+    //!
+    //! @return     number of tracks; -1 if address sector isn't loaded
+    //--------------------------------------------------------------------------
+    int trackCount() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get the audio ranges of a track
+    //!
+    //! @param[in]  track  The track number (starting with 1)
+    //!
+    //! @return     ranges in play order
+    //--------------------------------------------------------------------------
+    Ranges trackRanges(int track) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get the free space on disc
+    //!
+    //! @return     free ranges in free list order
+    //--------------------------------------------------------------------------
+    Ranges freeRanges() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get the length of a track in sound groups
+    //!
+    //! @param[in]  track  The track number (starting with 1)
+    //!
+    //! @return     sound groups
+    //--------------------------------------------------------------------------
+    uint32_t trackGroups(int track) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track title
+    //!
+    //! @param[in]  track      The track number (0 -> disc title)
+    //! @param[in]  fullWidth  use full width title sector
+    //!
+    //! @return     title
+    //--------------------------------------------------------------------------
+    std::string title(int track, bool fullWidth = false) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      get track time stamp
+    //!
+    //! @param[in]  track  The track number (0 -> disc)
+    //!
+    //! @return     time stamp; 0 if not set
+    //--------------------------------------------------------------------------
+    std::time_t tstamp(int track) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      set track title; the old title cells are released
+    //!             once the new title fits
+    //!
+    //! @param[in]  track      The track number (0 -> disc title)
+    //! @param[in]  title      The title (empty removes it)
+    //! @param[in]  fullWidth  use full width title sector
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int setTitle(int track, const std::string& title, bool fullWidth = false);
+
+    //--------------------------------------------------------------------------
+    //! @brief      set track time stamp
+    //!
+    //! @param[in]  track   The track number (0 -> disc)
+    //! @param[in]  tstamp  The time stamp
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int setTStamp(int track, std::time_t tstamp);
+
+    //--------------------------------------------------------------------------
+    //! @brief      take space from the free list (first fit in free list order)
+    //!
+    //! @param[in]  groups  The number of sound groups needed
+    //! @param[in]  mode    The track mode for the returned ranges
+    //! @param[out] ranges  The ranges taken
+    //!
+    //! @return     0 -> ok; -1 -> not enough free space
+    //--------------------------------------------------------------------------
+    int claimFree(uint32_t groups, uint8_t mode, Ranges& ranges);
+
+    //--------------------------------------------------------------------------
+    //! @brief      insert a new track; ranges must not be used by any track
+    //!
+    //! Parts of the ranges found in the free list are removed from it.
+    //! Following tracks are shifted up.
+    //!
+    //! @param[in]  track   The new track number (1 ... trackCount() + 1)
+    //! @param[in]  ranges  The audio ranges in play order
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int insertTrack(int track, const Ranges& ranges);
+
+    //--------------------------------------------------------------------------
+    //! @brief      erase a track; its audio is given back to the free list,
+    //!             titles and time stamp are released.
+    //!
+    //! @param[in]  track  The track number (starting with 1)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int eraseTrack(int track);
+
+    //--------------------------------------------------------------------------
+    //! @brief      move a track
+    //!
+    //! @param[in]  from  The source track number (starting with 1)
+    //! @param[in]  to    The destination track number (starting with 1)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int moveTrack(int from, int to);
+
+    //--------------------------------------------------------------------------
+    //! @brief      split a track; the second part becomes the next track
+    //!             (without title and time stamp), following tracks are
+    //!             shifted up.
+    //!
+    //! @param[in]  track   The track number (starting with 1)
+    //! @param[in]  groups  The split position in sound groups from track start
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int splitTrack(int track, uint32_t groups);
+
+    //--------------------------------------------------------------------------
+    //! @brief      join two tracks; the audio of the second track is appended
+    //!             to the first one, the second track is removed.
+    //!
+    //! @param[in]  first   The first track number (starting with 1)
+    //! @param[in]  second  The second track number (starting with 1)
+    //!
+    //! @return     0 -> ok; -1 -> error
+    //--------------------------------------------------------------------------
+    int joinTracks(int first, int second);
+
+protected:
+    /// bitmap with one bit per slot
+    using SlotMap = toc::SlotMap;
+
+    //--------------------------------------------------------------------------
+    //! @brief      typed access to sector images
+    //--------------------------------------------------------------------------
+    toc::UTOC_0* pos();
+    const toc::UTOC_0* pos() const;
+    toc::UTOC_1* titles(bool fullWidth);
+    const toc::UTOC_1* titles(bool fullWidth) const;
+    toc::UTOC_2* times();
+    const toc::UTOC_2* times() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      rebuild occupancy bitmaps and free slot chains if needed
+    //--------------------------------------------------------------------------
+    void buildSlotMaps();
+
+    //--------------------------------------------------------------------------
+    //! @brief      allocate a fragment slot
+    //!
+    //! @return     slot; 0 if none left
+    //--------------------------------------------------------------------------
+    uint8_t allocFrag();
+
+    //--------------------------------------------------------------------------
+    //! @brief      give a fragment slot back
+    //!
+    //! @param[in]  slot  The slot
+    //--------------------------------------------------------------------------
+    void releaseFrag(uint8_t slot);
+
+    //--------------------------------------------------------------------------
+    //! @brief      allocate a title cell
+    //!
+    //! @param[in]  fullWidth  use full width title sector
+    //!
+    //! @return     cell; 0 if none left
+    //--------------------------------------------------------------------------
+    uint8_t allocCell(bool fullWidth);
+
+    //--------------------------------------------------------------------------
+    //! @brief      give a title cell back
+    //!
+    //! @param[in]  fullWidth  use full width title sector
+    //! @param[in]  cell       The cell
+    //--------------------------------------------------------------------------
+    void releaseCell(bool fullWidth, uint8_t cell);
+
+    //--------------------------------------------------------------------------
+    //! @brief      release the title chain of a track
+    //!
+    //! @param[in]  track      The track number
+    //! @param[in]  fullWidth  use full width title sector
+    //--------------------------------------------------------------------------
+    void releaseTitle(int track, bool fullWidth);
+
+    //--------------------------------------------------------------------------
+    //! @brief      write ranges into a new fragment chain
+    //!
+    //! @param[in]  ranges  The ranges
+    //!
+    //! @return     first slot; 0 on error
+    //--------------------------------------------------------------------------
+    uint8_t writeChain(const Ranges& ranges);
+
+    //--------------------------------------------------------------------------
+    //! @brief      read ranges of a fragment chain
+    //!
+    //! @param[in]  slot  The first slot
+    //!
+    //! @return     ranges
+    //--------------------------------------------------------------------------
+    Ranges readChain(uint8_t slot) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief      release a fragment chain
+    //!
+    //! @param[in]  slot  The first slot
+    //--------------------------------------------------------------------------
+    void releaseChain(uint8_t slot);
+
+    //--------------------------------------------------------------------------
+    //! @brief      replace the free list (sorted, adjacent ranges merged)
+    //!
+    //! @param[in]  ranges  The free ranges
+    //!
+    //! @return     0 -> ok; -1 -> out of fragment slots
+    //--------------------------------------------------------------------------
+    int writeFreeList(Ranges ranges);
+
+    //--------------------------------------------------------------------------
+    //! @brief      release titles and time stamp of a track and remove its
+    //!             entries from the track maps
+    //!
+    //! @param[in]  track  The track number (audio must be released already)
+    //--------------------------------------------------------------------------
+    void dropTrack(int track);
+
+    //--------------------------------------------------------------------------
+    //! @brief      shift the per track maps
+    //!
+    //! @param[in]  from  first track to shift
+    //! @param[in]  to    last track to shift
+    //! @param[in]  dir   +1 -> shift up; -1 -> shift down
+    //--------------------------------------------------------------------------
+    void shiftMaps(int from, int to, int dir);
+
+    //--------------------------------------------------------------------------
+    //! @brief      mark sector as changed
+    //!
+    //! @param[in]  sector  The sector
+    //--------------------------------------------------------------------------
+    void touch(uint8_t sector);
+
+    //--------------------------------------------------------------------------
+    //! @brief      check a disc address
+    //!
+    //! @param[in]  addr  The address
+    //!
+    //! @return     true if valid
+    //--------------------------------------------------------------------------
+    static bool validAddr(const toc::discaddr& addr);
+
+private:
+    /// raw sector images
+    NetMDByteVector mSectors[SECTOR_COUNT];
+
+    /// changed sectors (bit per sector)
+    uint8_t mDirty;
+
+    /// used fragment slots
+    uint64_t mUsedFrags[4];
+
+    /// used title cells (half / full width)
+    uint64_t mUsedCells[2][4];
+
+    /// used time stamp slots
+    uint64_t mUsedTimes[4];
+
+    /// bitmaps and free chains match the images
+    bool mSlotMapsValid;
+};
+
+} // namespace netmd
@@ -0,0 +1,277 @@
+/*
+ * log.cpp
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#include <chrono>
+#include <thread>
+#include "log.h"
+
+/// log configuration
+structlog LOGCFG = {true, true, DEBUG, &std::cout, {}};
+
+namespace {
+
+/// ring size (power of 2)
+constexpr std::size_t RING_SIZE = 1024;
+
+/// ring index mask
+constexpr std::size_t RING_MASK = RING_SIZE - 1;
+
+/// writer sleep time if ring is empty
+constexpr std::chrono::milliseconds WRITER_IDLE{2};
+
+/// one ring slot; the sequence tells who owns the slot
+struct Slot
+{
+    std::atomic_size_t mSeq;
+    LogRecord mRec;
+};
+
+/// the ring (bounded MPSC queue)
+Slot sRing[RING_SIZE];
+
+/// next write position (producers)
+std::atomic_size_t sEnqPos{0};
+
+/// next read position (writer thread only)
+std::size_t sDeqPos = 0;
+
+/// records dropped since last report
+std::atomic_size_t sDropped{0};
+
+/// producers inside push() (stop() waits for them)
+std::atomic_size_t sInFlight{0};
+
+/// ring full policy
+std::atomic_int sPolicy{AsyncLog::DROP};
+
+/// stop marker for writer thread
+std::atomic_bool sStop{false};
+
+/// writer thread
+std::thread sWriter;
+
+/// serializes start / stop
+std::mutex sCtrlMtx;
+
+/// ring setup
+std::once_flag sRingInit;
+
+//------------------------------------------------------------------------------
+//! @brief      stops the writer at program exit
+//------------------------------------------------------------------------------
+struct AsyncLogGuard
+{
+    ~AsyncLogGuard()
+    {
+        AsyncLog::stop();
+    }
+} sGuard;
+
+} // ~namespace
+
+/// sink active marker
+std::atomic_bool AsyncLog::smActive{false};
+
+//--------------------------------------------------------------------------
+//! @brief      start writer thread
+//!
+//! @param[in]  policy  The ring full policy
+//--------------------------------------------------------------------------
+void AsyncLog::start(Policy policy)
+{
+    std::unique_lock<std::mutex> lck(sCtrlMtx);
+
+    std::call_once(sRingInit, []()
+    {
+        for (std::size_t i = 0; i < RING_SIZE; i++)
+        {
+            sRing[i].mSeq.store(i, std::memory_order_relaxed);
+        }
+    });
+
+    sPolicy.store(policy, std::memory_order_relaxed);
+
+    if (!sWriter.joinable())
+    {
+        sStop   = false;
+        sWriter = std::thread(&AsyncLog::writer);
+        smActive.store(true, std::memory_order_release);
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      stop writer thread, write out pending records
+//--------------------------------------------------------------------------
+void AsyncLog::stop()
+{
+    std::unique_lock<std::mutex> lck(sCtrlMtx);
+
+    if (sWriter.joinable())
+    {
+        smActive.store(false, std::memory_order_seq_cst);
+        sStop = true;
+        sWriter.join();
+
+        // a producer might have reserved a slot but not yet published it
+        while (sInFlight.load(std::memory_order_seq_cst) != 0)
+        {
+            std::this_thread::yield();
+        }
+
+        // records pushed while we were stopping
+        drain();
+    }
+}
+
+//--------------------------------------------------------------------------
+//! @brief      hand over a record to the writer thread
+//!
+//! @param      rec   The record
+//!
+//! @return     false if sink isn't active; true if queued (or dropped)
+//--------------------------------------------------------------------------
+bool AsyncLog::push(LogRecord&& rec)
+{
+    // announce ourself before checking the active flag; stop() does
+    // it the other way round, so either we see it stopping or it sees us
+    sInFlight.fetch_add(1, std::memory_order_seq_cst);
+
+    struct InFlightGuard
+    {
+        ~InFlightGuard()
+        {
+            sInFlight.fetch_sub(1, std::memory_order_release);
+        }
+    } guard;
+
+    if (!smActive.load(std::memory_order_seq_cst))
+    {
+        return false;
+    }
+
+    std::size_t pos = sEnqPos.load(std::memory_order_relaxed);
+    Slot* pSlot;
+
+    for (;;)
+    {
+        pSlot = &sRing[pos & RING_MASK];
+        std::size_t seq = pSlot->mSeq.load(std::memory_order_acquire);
+        auto dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+        if (dif == 0)
+        {
+            if (sEnqPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (dif < 0)
+        {
+            // ring is full; while stopping the caller writes directly
+            if (!active())
+            {
+                return false;
+            }
+
+            if (sPolicy.load(std::memory_order_relaxed) == DROP)
+            {
+                sDropped.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            std::this_thread::yield();
+            pos = sEnqPos.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            pos = sEnqPos.load(std::memory_order_relaxed);
+        }
+    }
+
+    pSlot->mRec = std::move(rec);
+    pSlot->mSeq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+//--------------------------------------------------------------------------
+//! @brief      writer thread function
+//--------------------------------------------------------------------------
+void AsyncLog::writer()
+{
+    while (!sStop)
+    {
+        if (drain() == 0)
+        {
+            std::this_thread::sleep_for(WRITER_IDLE);
+        }
+    }
+    drain();
+}
+
+//--------------------------------------------------------------------------
+//! @brief      write all queued records to the log stream
+//!
+//! @return     number of records written
+//--------------------------------------------------------------------------
+std::size_t AsyncLog::drain()
+{
+    std::size_t cnt     = 0;
+    std::size_t dropped = sDropped.exchange(0, std::memory_order_relaxed);
+    LogRecord rec;
+
+    std::unique_lock<std::mutex> lck(LOGCFG.mtxLog);
+
+    for (;;)
+    {
+        Slot& slot = sRing[sDeqPos & RING_MASK];
+
+        if (slot.mSeq.load(std::memory_order_acquire) != (sDeqPos + 1))
+        {
+            break;
+        }
+
+        rec = std::move(slot.mRec);
+        slot.mRec = LogRecord{};
+        slot.mSeq.store(sDeqPos + RING_SIZE, std::memory_order_release);
+        sDeqPos++;
+
+        *LOGCFG.sout << LOG::format(rec);
+        cnt++;
+    }
+
+    if (dropped)
+    {
+        *LOGCFG.sout << "WARN|" << dropped << " log message(s) dropped (log ring full)" << std::endl;
+    }
+
+    if (cnt || dropped)
+    {
+        LOGCFG.sout->flush();
+    }
+
+    return cnt;
+}
@@ -14,6 +14,9 @@
 #include <sstream>
 #include <mutex>
 #include <vector>
+#include <atomic>
+#include <string_view>
+#include <cstdint>
 
 enum typelog
 {
@@ -24,11 +27,16 @@ enum typelog
     CAPTURE //!< needed for log parcing!
 };
 
+/// compile time log floor; messages below are removed from the build
+#ifndef NETMD_MIN_LOG_LEVEL
+    #define NETMD_MIN_LOG_LEVEL DEBUG
+#endif
+
 struct structlog
 {
     bool headers = false;
     bool time = false;
-    int level = WARN;
+    std::atomic_int level = WARN;  ///< read relaxed on every log statement
     std::ostream* sout = &std::cerr;
     std::mutex mtxLog;
 };
@@ -57,11 +65,97 @@ extern structlog LOGCFG;
         return prettyFunction.substr(space, bracket-space);
     }
     #define __METHOD_NAME__ method_name(__PRETTY_FUNCTION__)
+    #define __FLOW_FUNC__   __PRETTY_FUNCTION__
 #else
     #define __METHOD_NAME__ __FUNCTION__
+    #define __FLOW_FUNC__   __FUNCTION__
 #endif
 
-#define mLOG(x_) LOG(x_) << __METHOD_NAME__ << "():" << __LINE__ << ": "
+//! @note  The level check comes first, so a filtered message costs one
+//!        relaxed load - no argument is evaluated, no lock is taken.
+#define mLOG(x_) if (!LOG::enabled(x_)) {} else LOG(x_) << __METHOD_NAME__ << "():" << __LINE__ << ": "
+
+//------------------------------------------------------------------------------
+//! @brief      one finished log message
+//------------------------------------------------------------------------------
+struct LogRecord
+{
+    std::string mText;              ///< formatted message
+    std::size_t mHexPos = 0;        ///< where the hex dump goes into the text
+    std::vector<uint8_t> mHex;      ///< raw hex dump (formatted on output)
+};
+
+//------------------------------------------------------------------------------
+//! @brief      raw data to be logged as hex dump
+//------------------------------------------------------------------------------
+struct HexData
+{
+    std::vector<uint8_t> mData;     ///< data to dump
+};
+
+//------------------------------------------------------------------------------
+//! @brief      Asynchronous log sink. Finished records are pushed onto a
+//!             lock-free MPSC ring; a writer thread drains it to the log
+//!             stream. If the ring is full, records are dropped (and counted)
+//!             or the logging thread waits for a free slot - see Policy.
+//------------------------------------------------------------------------------
+class AsyncLog
+{
+public:
+    /// what to do if the ring is full
+    enum Policy
+    {
+        DROP,   ///< drop the record (never stalls the logging thread)
+        BLOCK   ///< wait until the writer made room
+    };
+
+    //--------------------------------------------------------------------------
+    //! @brief      start writer thread
+    //!
+    //! @param[in]  policy  The ring full policy
+    //--------------------------------------------------------------------------
+    static void start(Policy policy = DROP);
+
+    //--------------------------------------------------------------------------
+    //! @brief      stop writer thread, write out pending records
+    //--------------------------------------------------------------------------
+    static void stop();
+
+    //--------------------------------------------------------------------------
+    //! @brief      is the async sink active?
+    //!
+    //! @return     true if so
+    //--------------------------------------------------------------------------
+    static bool active()
+    {
+        return smActive.load(std::memory_order_acquire);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      hand over a record to the writer thread
+    //!
+    //! @param      rec   The record
+    //!
+    //! @return     false if sink isn't active; true if queued (or dropped)
+    //--------------------------------------------------------------------------
+    static bool push(LogRecord&& rec);
+
+private:
+    //--------------------------------------------------------------------------
+    //! @brief      writer thread function
+    //--------------------------------------------------------------------------
+    static void writer();
+
+    //--------------------------------------------------------------------------
+    //! @brief      write all queued records to the log stream
+    //!
+    //! @return     number of records written
+    //--------------------------------------------------------------------------
+    static std::size_t drain();
+
+    /// sink active marker
+    static std::atomic_bool smActive;
+};
 
 //------------------------------------------------------------------------------
 //! @brief      This class describes a log helper
@@ -74,13 +168,14 @@ public:
     LOG(int type)
     {
         msglevel = type;
+        opened   = enabled(type);
 
-        if(LOGCFG.time)
+        if(opened && LOGCFG.time)
         {
-		            *this << timeStamp();
+            *this << timeStamp();
         }
 
-        if(LOGCFG.headers)
+        if(opened && LOGCFG.headers)
         {
             *this  << getLabel(type) << "|";
         }
@@ -88,10 +183,10 @@ public:
 
     ~LOG()
     {
-        std::unique_lock<std::mutex> lck(LOGCFG.mtxLog);
         if(opened)
         {
-            *LOGCFG.sout << std::endl;
+            oss << std::endl;
+            write({oss.str(), hexPos, std::move(hex)});
         }
         opened = false;
     }
@@ -99,86 +194,101 @@ public:
     template<class T>
     LOG &operator<<(const T &msg)
     {
-        std::unique_lock<std::mutex> lck(LOGCFG.mtxLog);
-        if(msglevel >= LOGCFG.level)
+        if(opened)
         {
-            *LOGCFG.sout << msg << std::flush;
-            opened = true;
+            oss << msg;
         }
         return *this;
     }
 
-    static std::string hexFormat(int sev, const unsigned char* data, std::size_t dataLen)
+    //! @note  With the async sink the hex dump is formatted by the writer
+    //!        thread, not on the (USB) thread which logs it.
+    LOG &operator<<(HexData&& data)
     {
-        if (sev < LOGCFG.level)
+        if(opened)
         {
-            return std::string{};
+            if(AsyncLog::active() && hex.empty())
+            {
+                hexPos = static_cast<std::size_t>(oss.tellp());
+                hex    = std::move(data.mData);
+            }
+            else
+            {
+                oss << hexString(data.mData.data(), data.mData.size());
+            }
         }
+        return *this;
+    }
 
-        std::ostringstream oss;
-        std::size_t i;
-        std::size_t j = 0;
-        int breakpoint = 0;
-
-        oss << std::endl;
+    //--------------------------------------------------------------------------
+    //! @brief      check if a log level is enabled (compile time and runtime)
+    //!
+    //! @param[in]  sev   The log level
+    //!
+    //! @return     true if enabled
+    //--------------------------------------------------------------------------
+    static bool enabled(int sev)
+    {
+        return (sev >= NETMD_MIN_LOG_LEVEL)
+            && (sev >= LOGCFG.level.load(std::memory_order_relaxed));
+    }
 
-        for (i = 0; i < dataLen; i++)
+    //--------------------------------------------------------------------------
+    //! @brief      write a finished log record (async sink or log stream)
+    //!
+    //! @param      rec   The record
+    //--------------------------------------------------------------------------
+    static void write(LogRecord&& rec)
+    {
+        if(!AsyncLog::push(std::move(rec)))
         {
-            oss << std::hex << std::setw(2) << std::setfill('0')
-                << static_cast<int>(data[i]) << std::dec << " ";
-
-            breakpoint++;
-
-            if(!((i + 1) % 16) && i)
-            {
-                oss << "\t\t";
-
-                for(j = ((i + 1) - 16); j < ((i + 1) / 16) * 16; j++)
-                {
-                    if(data[j] < 30)
-                    {
-                        oss << ".";
-                    }
-                    else
-                    {
-                        oss << data[j];
-                    }
-                }
-                oss << std::endl;
-                breakpoint = 0;
-            }
+            std::unique_lock<std::mutex> lck(LOGCFG.mtxLog);
+            *LOGCFG.sout << format(rec) << std::flush;
         }
+    }
 
-        if(breakpoint == 16)
+    //--------------------------------------------------------------------------
+    //! @brief      format a log record (insert hex dump)
+    //!
+    //! @param[in]  rec   The record
+    //!
+    //! @return     log line(s)
+    //--------------------------------------------------------------------------
+    static std::string format(const LogRecord& rec)
+    {
+        if(rec.mHex.empty())
         {
-            return oss.str();
+            return rec.mText;
         }
 
-        for(; breakpoint < 16; breakpoint++)
+        return rec.mText.substr(0, rec.mHexPos)
+            + hexString(rec.mHex.data(), rec.mHex.size())
+            + rec.mText.substr(rec.mHexPos);
+    }
+
+    static HexData hexFormat(int sev, const unsigned char* data, std::size_t dataLen)
+    {
+        if (!enabled(sev))
         {
-            oss << "   ";
+            return HexData{};
         }
 
-        oss << "\t\t";
+        return HexData{std::vector<uint8_t>(data, data + dataLen)};
+    }
 
-        for(j = dataLen - (dataLen % 16); j < dataLen; j++)
+    static HexData hexFormat(int sev, const std::vector<uint8_t>& data)
+    {
+        if (!enabled(sev))
         {
-            if(data[j] < 30)
-            {
-                oss << ".";
-            }
-            else
-            {
-                oss << data[j];
-            }
+            return HexData{};
         }
 
-        return oss.str();
+        return HexData{data};
     }
 
-    static std::string hexFormat(int sev, const std::vector<uint8_t>& data)
+    static std::string hexString(const unsigned char* data, std::size_t dataLen)
     {
-        if (sev < LOGCFG.level)
+        if (dataLen == 0)
         {
             return std::string{};
         }
@@ -186,7 +296,6 @@ public:
         std::ostringstream oss;
         std::size_t i;
         std::size_t j = 0;
-        std::size_t dataLen = data.size();
         int breakpoint = 0;
 
         oss << std::endl;
@@ -249,9 +358,17 @@ public:
     {
         std::ostringstream oss;
         auto time = std::time(nullptr);
+        std::tm tm{};
+
+        // log lines are built concurrently -> reentrant localtime
+#ifdef _WIN32
+        localtime_s(&tm, &time);
+#else
+        localtime_r(&time, &tm);
+#endif
 
         // ISO 8601: %Y-%m-%d %H:%M:%S, e.g. 2017-07-31 00:42:00+0200.
-        oss <<  std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S|");
+        oss <<  std::put_time(&tm, "%Y-%m-%d %H:%M:%S|");
         return oss.str();
     }
 
@@ -272,9 +389,17 @@ public:
 private:
     bool opened = false;
     int msglevel = DEBUG;
+    std::ostringstream oss;
+    std::size_t hexPos = 0;
+    std::vector<uint8_t> hex;
 };
 
-#define mFLOW(x_) Flow flow_(x_, std::string{__METHOD_NAME__})
+inline std::ostream& operator<<(std::ostream& os, const HexData& data)
+{
+    return os << LOG::hexString(data.mData.data(), data.mData.size());
+}
+
+#define mFLOW(x_) Flow flow_(x_, __FLOW_FUNC__)
 
 //------------------------------------------------------------------------------
 //! @brief      Helper class to indicate the program flow
@@ -282,47 +407,47 @@ private:
 class Flow
 {
 public:
-    Flow(int sev, const std::string& f) 
-        : mMsglevel(sev), mFunc(f)
+    Flow(int sev, const char* f) 
+        : mMsglevel(sev), mActive(LOG::enabled(sev)), mFunc(f)
     {
-        std::unique_lock<std::mutex> lck(LOGCFG.mtxLog);
-
-        if(LOGCFG.time && mMsglevel >= LOGCFG.level)
-        {
-            *LOGCFG.sout << LOG::timeStamp();
-        }
-
-        if(LOGCFG.headers && mMsglevel >= LOGCFG.level)
-        {
-            *LOGCFG.sout  << LOG::getLabel(mMsglevel) << "|";
-        }
-
-        if(LOGCFG.headers && mMsglevel >= LOGCFG.level)
+        if(mActive)
         {
-            *LOGCFG.sout << mFunc << "() --> in" << std::endl;
+            print("() --> in");
         }
     }
 
     ~Flow()
     {
-        std::unique_lock<std::mutex> lck(LOGCFG.mtxLog);
-        if(LOGCFG.time && mMsglevel >= LOGCFG.level)
+        if(mActive)
         {
-            *LOGCFG.sout << LOG::timeStamp();
+            print("() <-- out");
         }
+    }
+
+private:
+    void print(const char* dir) const
+    {
+        std::ostringstream oss;
 
-        if(LOGCFG.headers && mMsglevel >= LOGCFG.level)
+        if(LOGCFG.time)
         {
-            *LOGCFG.sout  << LOG::getLabel(mMsglevel) << "|";
+            oss << LOG::timeStamp();
         }
 
-        if(mMsglevel >= LOGCFG.level)
+        if(LOGCFG.headers)
         {
-            *LOGCFG.sout << mFunc << "() <-- out" << std::endl;
+            oss << LOG::getLabel(mMsglevel) << "|";
         }
+
+#ifdef __GNUC__
+        oss << method_name(mFunc) << dir << std::endl;
+#else
+        oss << mFunc << dir << std::endl;
+#endif
+        LOG::write({oss.str(), 0, {}});
     }
 
-private:
     int mMsglevel;
-    std::string mFunc;
+    bool mActive;
+    const char* mFunc;
 };
@@ -100,6 +100,7 @@ namespace toc
     };
 
     //! UTOC sector #1 (Title info). 2352 bytes
+    //! Sector #4 (full width titles, 2 byte characters) has the same layout.
     struct UTOC_1
     {
         uint8_t unknown[0x2f];
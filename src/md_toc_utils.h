@@ -0,0 +1,166 @@
+/*
+ * md_toc_utils.h
+ *
+ * This file is part of netmd++, a library for accessing NetMD devices.
+ *
+ * It makes use of knowledge / code collected by Marc Britten and
+ * Alexander Sulfrian for the Linux Minidisc project.
+ *
+ * Asivery helped to make this possible!
+ * Sir68k discovered the Sony FW exploit!
+ *
+ * Copyright (C) 2023 Jo2003 (olenka.joerg@gmail.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include "md_toc.h"
+
+namespace netmd
+{
+namespace toc
+{
+    //! occupancy map with one bit per TOC slot (bit n -> slot n)
+    using SlotMap = uint64_t[4];
+
+    //--------------------------------------------------------------------------
+    //! @brief      set / clear a slot in a slot map
+    //!
+    //! @param      map   The slot map
+    //! @param[in]  slot  The slot
+    //! @param[in]  used  The new state
+    //--------------------------------------------------------------------------
+    inline void markSlot(SlotMap& map, uint8_t slot, bool used)
+    {
+        if (used)
+        {
+            map[slot >> 6] |= (1ull << (slot & 63));
+        }
+        else
+        {
+            map[slot >> 6] &= ~(1ull << (slot & 63));
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      check if slot is used
+    //!
+    //! @param[in]  map   The slot map
+    //! @param[in]  slot  The slot
+    //!
+    //! @return     true if used
+    //--------------------------------------------------------------------------
+    inline bool slotUsed(const SlotMap& map, uint8_t slot)
+    {
+        return (map[slot >> 6] & (1ull << (slot & 63))) != 0;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      find first free slot in a slot map
+    //!
+    //! @param[in]  map   The slot map
+    //!
+    //! @return     slot number or -1 if all slots are used
+    //--------------------------------------------------------------------------
+    inline int firstFreeSlot(const SlotMap& map)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            if (~map[i])
+            {
+                return (i << 6) + __builtin_ctzll(~map[i]);
+            }
+        }
+        return -1;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      decimal value to time stamp notation (0x59 means 59)
+    //!
+    //! @param[in]  v     The value (0 ... 99)
+    //!
+    //! @return     BCD value
+    //--------------------------------------------------------------------------
+    inline uint8_t decToBcd(int v)
+    {
+        return static_cast<uint8_t>(((v / 10) << 4) | ((v % 10) & 0xf));
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      time stamp notation to decimal value
+    //!
+    //! @param[in]  v     The BCD value
+    //!
+    //! @return     decimal value
+    //--------------------------------------------------------------------------
+    inline int bcdToDec(uint8_t v)
+    {
+        return ((v >> 4) * 10) + (v & 0xf);
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      fill date and time of a time stamp (signature untouched)
+    //!
+    //! @param      ts    The time stamp
+    //! @param[in]  tm    The broken down time (UTC)
+    //--------------------------------------------------------------------------
+    inline void setTimestamp(timestamp& ts, const std::tm& tm)
+    {
+        ts.d  = decToBcd(tm.tm_mday);           // 1 ... 31
+        ts.mo = decToBcd(tm.tm_mon + 1);        // 0 ... 11
+        ts.y  = decToBcd(tm.tm_year % 100);     // since 1900
+        ts.h  = decToBcd(tm.tm_hour);           // 0 ... 23
+        ts.m  = decToBcd(tm.tm_min);            // 0 ... 59
+        ts.s  = decToBcd(tm.tm_sec);            // 0 ... 59
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief      convert time stamp to time
+    //!
+    //! @param[in]  ts    The time stamp
+    //!
+    //! @return     time (UTC) or 0 if time stamp is invalid
+    //--------------------------------------------------------------------------
+    inline std::time_t timestampToTime(const timestamp& ts)
+    {
+        // years 00 ... 89 -> 2000 ... 2089, 90 ... 99 -> 1990 ... 1999
+        int64_t y  = bcdToDec(ts.y);
+        int64_t mo = bcdToDec(ts.mo);
+        int64_t d  = bcdToDec(ts.d);
+
+        y += (y < 90) ? 2000 : 1900;
+
+        if ((mo < 1) || (mo > 12) || (d < 1) || (d > 31))
+        {
+            return 0;
+        }
+
+        // days since epoch (proleptic gregorian calendar)
+        y -= (mo <= 2) ? 1 : 0;
+        int64_t era  = y / 400;
+        int64_t yoe  = y - era * 400;
+        int64_t doy  = (153 * (mo + ((mo > 2) ? -3 : 9)) + 2) / 5 + d - 1;
+        int64_t doe  = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        int64_t days = era * 146'097 + doe - 719'468;
+
+        return static_cast<std::time_t>(days * 86'400
+                                        + bcdToDec(ts.h) * 3'600
+                                        + bcdToDec(ts.m) * 60
+                                        + bcdToDec(ts.s));
+    }
+}} // ~namespaces
@@ -34,6 +34,7 @@
 #include <variant>
 #include <string>
 #include <functional>
+#include <ctime>
 
 namespace  netmd  {
 
@@ -55,6 +56,13 @@ using NetMDParams     = std::vector<NetMDParam>;
 //--------------------------------------------------------------------------
 using EvtCallback = std::function<void(bool)>;
 
+//--------------------------------------------------------------------------
+//! @brief progress callback function signature
+//
+//! @param[in]  progress in percent (0 ... 100)
+//--------------------------------------------------------------------------
+using ProgressCallback = std::function<void(int)>;
+
 /// type definitaion stored in param
 enum NetMDParamType
 {
@@ -171,6 +179,46 @@ struct Group
 
 using Groups = std::vector<Group>;
 
+//-----------------------------------------------------------------------------
+//! @brief      all meta data of one track
+//-----------------------------------------------------------------------------
+struct TrackInfo
+{
+    uint16_t        mNo;            //!< track number (starting with 0)
+    std::string     mTitle;         //!< track title
+    TrackTime       mTime;          //!< track length
+    AudioEncoding   mEncoding;      //!< audio encoding
+    uint8_t         mChannel;       //!< channel flag
+    TrackProtection mProtection;    //!< track protection
+    uint32_t        mLengthMs;      //!< exact length in ms (UTOC listing only)
+    std::time_t     mTStamp;        //!< recording time (UTOC listing only)
+};
+
+using TrackInfos = std::vector<TrackInfo>;
+
+//-----------------------------------------------------------------------------
+//! @brief      snapshot of the disc content
+//-----------------------------------------------------------------------------
+struct DiscSnapshot
+{
+    bool        mValid;     //!< true if snapshot is valid
+    int         mDiscFlags; //!< disc flags
+    std::string mDiscTitle; //!< disc title
+    Groups      mGroups;    //!< track groups
+    TrackInfos  mTracks;    //!< all tracks
+};
+
+//-----------------------------------------------------------------------------
+//! @brief      one track of an album upload
+//-----------------------------------------------------------------------------
+struct AlbumTrack
+{
+    std::string mFileName;  //!< PCM WAVE file (44.1kHz / 16 bit)
+    std::string mTitle;     //!< track title
+};
+
+using AlbumTracks = std::vector<AlbumTrack>;
+
 constexpr uint8_t NETMD_CHANNELS_MONO   = 0x01;
 constexpr uint8_t NETMD_CHANNELS_STEREO = 0x00;
 
@@ -82,6 +82,44 @@ int main (int argc, char* argv[])
         return 0;
     }
 
+    if ((argc == 3) && !strcmp("checkUtoc", argv[1]))
+    {
+        CNetMdUTOC utoc;
+        std::vector<std::string> errors;
+
+        if (utoc.loadFile(argv[2]) != 0)
+        {
+            return 1;
+        }
+
+        utoc.validate(errors);
+
+        for (const auto& e : errors)
+        {
+            std::cout << e << std::endl;
+        }
+
+        std::cout << errors.size() << " error(s) found." << std::endl;
+        return errors.empty() ? 0 : 1;
+    }
+
+    if ((argc == 4) && !strcmp("diffUtoc", argv[1]))
+    {
+        CNetMdUTOC a, b;
+
+        if ((a.loadFile(argv[2]) != 0) || (b.loadFile(argv[3]) != 0))
+        {
+            return 1;
+        }
+
+        for (const auto& d : a.diff(b))
+        {
+            std::cout << "sector " << static_cast<int>(d.mSector) << ", offset 0x" << std::hex
+                      << d.mOffset << ", size 0x" << d.mSize << std::dec << std::endl;
+        }
+        return 0;
+    }
+
     netmd_pp* pNetMD = nullptr;
 
     std::vector<uint32_t> featTest = {(SP_UPLOAD | USB_EXEC), SP_UPLOAD, (USB_EXEC | PCM_2_MONO), PCM_SPEEDUP, (USB_EXEC | PCM_2_MONO)};